@@ -0,0 +1,448 @@
+/*
+ * analysis.c - FFT size cache and the STFT analysis stage.
+ */
+
+#include "analysis.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define PEAK_HOLD_DECAY 0.9995
+#define POWER_FLOOR 1e-18           // As in the power_to_db kernels.
+
+int fft_size_is_valid(int n) {
+    return n >= MIN_FFT_SIZE && n <= MAX_FFT_SIZE && (n & (n - 1)) == 0;
+}
+
+// Circular autocorrelation, lags 0..size / 2, from a real signal's
+// non-negative bins. The power spectrum is real and even, so its forward
+// transform is the (unscaled) inverse one. `work` holds `size` doubles,
+// and `spectrum` is overwritten.
+static void autocorrelate(const FFTPlan* plan, Complex* spectrum, double* work, double* acf, int size) {
+    const int half = size / 2;
+    for (int k = 0; k <= half; ++k) {
+        work[k] = spectrum[k].real * spectrum[k].real + spectrum[k].imag * spectrum[k].imag;
+    }
+    for (int k = 1; k < half; ++k) work[size - k] = work[k];
+    fft_real_forward(plan, work, spectrum);
+    for (int lag = 0; lag <= half; ++lag) acf[lag] = spectrum[lag].real;
+}
+
+static int size_index(int size) {
+    int index = 0;
+    while ((MIN_FFT_SIZE << index) < size) ++index;
+    return index;
+}
+
+const FFTSetup* fft_setup_get(FFTSetupCache* cache, int size) {
+    if (!fft_size_is_valid(size)) return NULL;
+    FFTSetup* setup = &cache->setups[size_index(size)];
+    if (setup->size == size) return setup;
+
+    const size_t window_bytes = size * sizeof(double);
+    const size_t acf_bytes = (size / 2 + 1) * sizeof(double);
+    setup->plan = fft_plan_create(size);
+    int arena_ok = arena_init(&setup->arena, arena_slice_size(window_bytes) + arena_slice_size(acf_bytes));
+    double* work = malloc(size * sizeof(double));
+    Complex* spectrum = malloc((size / 2 + 1) * sizeof(Complex));
+    if (!setup->plan || !arena_ok || !work || !spectrum) {
+        fft_plan_destroy(setup->plan);
+        arena_free(&setup->arena);
+        free(work); free(spectrum);
+        setup->plan = NULL;
+        return NULL;
+    }
+    setup->window = arena_take(&setup->arena, window_bytes);
+    setup->window_acf = arena_take(&setup->arena, acf_bytes);
+    double window_sum = 0.0;
+    for (int i = 0; i < size; ++i) {
+        setup->window[i] = 0.5 * (1 - cos(2 * M_PI * i / (size - 1)));
+        window_sum += setup->window[i];
+    }
+    // A sine of amplitude A peaks at A * window_sum / 2 in its bin; scaling
+    // the taper puts a full-scale one at FULL_SCALE_DB for every size.
+    const double gain = pow(10.0, FULL_SCALE_DB / 20.0) / (32768.0 * window_sum / 2.0);
+    for (int i = 0; i < size; ++i) setup->window[i] *= gain;
+
+    // The window's own autocorrelation, taken the same way as a frame's,
+    // so the pitch tracker can divide out the taper it puts on every lag.
+    fft_real_forward(setup->plan, setup->window, spectrum);
+    autocorrelate(setup->plan, spectrum, work, setup->window_acf, size);
+    for (int lag = size / 2; lag >= 0; --lag) setup->window_acf[lag] /= setup->window_acf[0];
+    free(work); free(spectrum);
+
+    setup->size = size;
+    return setup;
+}
+
+void fft_setup_cache_free(FFTSetupCache* cache) {
+    for (int i = 0; i < FFT_SIZE_COUNT; ++i) {
+        fft_plan_destroy(cache->setups[i].plan);
+        arena_free(&cache->setups[i].arena);
+        cache->setups[i].plan = NULL; cache->setups[i].window = NULL; cache->setups[i].window_acf = NULL;
+        cache->setups[i].size = 0;
+    }
+}
+
+int analyzer_init(Analyzer* an, int fft_size, int hop_size, double sample_rate) {
+    memset(an, 0, sizeof(*an));
+    an->sample_rate = sample_rate;
+    an->kernels = dsp_kernels_best();
+    an->hop_size = fft_size;
+    if (!analyzer_set_fft_size(an, fft_size)) {
+        analyzer_free(an);
+        return 0;
+    }
+    analyzer_set_hop_size(an, hop_size);
+    return 1;
+}
+
+void analyzer_free(Analyzer* an) {
+    fft_setup_cache_free(&an->cache);
+    arena_free(&an->arena);
+    arena_free(&an->average.arena);
+    an->history = NULL; an->fft_input = NULL; an->spectrum = NULL;
+    an->magnitude_db = NULL; an->peak_hold = NULL; an->pitch_curve = NULL;
+    an->fft = NULL;
+}
+
+int analyzer_set_fft_size(Analyzer* an, int fft_size) {
+    const FFTSetup* setup = fft_setup_get(&an->cache, fft_size);
+    if (!setup) return 0;
+    const int bins = fft_size / 2;
+    const size_t history_bytes = 2 * fft_size * sizeof(Sint16);
+    const size_t input_bytes = fft_size * sizeof(double);
+    const size_t spectrum_bytes = (bins + 1) * sizeof(Complex);
+    const size_t bins_bytes = bins * sizeof(double);
+    const size_t curve_bytes = (bins + 1) * sizeof(double);
+    Arena arena;
+    if (!arena_init(&arena, arena_slice_size(history_bytes) + arena_slice_size(input_bytes) + arena_slice_size(spectrum_bytes) +
+                            2 * arena_slice_size(bins_bytes) + arena_slice_size(curve_bytes))) return 0;
+    Sint16* history = arena_take(&arena, history_bytes);
+    double* fft_input = arena_take(&arena, input_bytes);
+    Complex* spectrum = arena_take(&arena, spectrum_bytes);
+    double* magnitude_db = arena_take(&arena, bins_bytes);
+    double* peak_hold = arena_take(&arena, bins_bytes);
+    double* pitch_curve = arena_take(&arena, curve_bytes);
+
+    // Carry the newest samples over so the first frame at the new size is
+    // not mostly silence.
+    if (an->fft) {
+        int old_size = an->fft->size;
+        int keep = old_size < fft_size ? old_size : fft_size;
+        const Sint16* newest = an->history + an->history_pos + old_size - keep;
+        memcpy(history + fft_size - keep, newest, keep * sizeof(Sint16));
+        memcpy(history + 2 * fft_size - keep, newest, keep * sizeof(Sint16));
+        an->hop_size = (int)((double)an->hop_size * fft_size / old_size);
+    }
+
+    arena_free(&an->arena);
+    an->arena = arena;
+    an->history = history;
+    an->fft_input = fft_input;
+    an->spectrum = spectrum;
+    an->magnitude_db = magnitude_db;
+    an->peak_hold = peak_hold;
+    an->pitch_curve = pitch_curve;
+    an->history_pos = 0;
+    an->pending = 0;
+    an->fft = setup;
+    analyzer_set_hop_size(an, an->hop_size);
+    analyzer_reset_peak_hold(an);
+    if (an->average.mode != AVERAGE_OFF) analyzer_set_averaging(an, an->average.mode, an->average.frames, an->average.time_constant);
+    return 1;
+}
+
+void analyzer_set_hop_size(Analyzer* an, int hop_size) {
+    if (hop_size < 1) hop_size = 1;
+    if (hop_size > an->fft->size) hop_size = an->fft->size;
+    an->hop_size = hop_size;
+    if (an->pending >= hop_size) an->pending = hop_size - 1;
+}
+
+void analyzer_reset_peak_hold(Analyzer* an) {
+    for (int i = 0; i < an->fft->size / 2; ++i) {
+        an->peak_hold[i] = -1000.0;
+    }
+}
+
+// --- Averaging ---
+
+static void average_restart(SpectrumAverage* av, int bins) {
+    av->ring_pos = 0;
+    av->count = 0;
+    if (av->mode == AVERAGE_OFF) return;
+    for (int i = 0; i < bins; ++i) {
+        av->level_db[i] = -1000.0;
+        av->min_db[i] = 1000.0;
+        av->deviation_db[i] = av->sum_db[i] = av->sum_sq_db[i] = 0.0;
+    }
+    if (av->sum_power) memset(av->sum_power, 0, bins * sizeof(double));
+}
+
+// Sizes the buffers for `bins` bins. Only the linear and RMS modes have a
+// ring, and only RMS sums power.
+static int average_layout(SpectrumAverage* av, int bins) {
+    arena_free(&av->arena);
+    av->level_db = av->deviation_db = av->min_db = NULL;
+    av->sum_db = av->sum_sq_db = av->sum_power = NULL;
+    av->ring_db = av->ring_power = NULL;
+    if (av->mode == AVERAGE_OFF) return 1;
+
+    const int power = av->mode == AVERAGE_RMS;
+    const int ring_frames = av->mode == AVERAGE_EXPONENTIAL ? 0 : av->frames;
+    const size_t bins_bytes = bins * sizeof(double);
+    const size_t ring_bytes = (size_t)ring_frames * bins * sizeof(float);
+    if (!arena_init(&av->arena, (5 + power) * arena_slice_size(bins_bytes) + (1 + power) * arena_slice_size(ring_bytes))) {
+        av->mode = AVERAGE_OFF;
+        return 0;
+    }
+    av->level_db = arena_take(&av->arena, bins_bytes);
+    av->deviation_db = arena_take(&av->arena, bins_bytes);
+    av->min_db = arena_take(&av->arena, bins_bytes);
+    av->sum_db = arena_take(&av->arena, bins_bytes);
+    av->sum_sq_db = arena_take(&av->arena, bins_bytes);
+    if (power) av->sum_power = arena_take(&av->arena, bins_bytes);
+    if (ring_frames) av->ring_db = arena_take(&av->arena, ring_bytes);
+    if (ring_frames && power) av->ring_power = arena_take(&av->arena, ring_bytes);
+    average_restart(av, bins);
+    return 1;
+}
+
+// Rebuilds the ring's sums from the frames it holds, once a lap, so the
+// rounding of adding and removing frames never piles up.
+static void average_resum(SpectrumAverage* av, int bins) {
+    memset(av->sum_db, 0, bins * sizeof(double));
+    memset(av->sum_sq_db, 0, bins * sizeof(double));
+    if (av->sum_power) memset(av->sum_power, 0, bins * sizeof(double));
+    for (int f = 0; f < av->count; ++f) {
+        const float* db = av->ring_db + (size_t)f * bins;
+        for (int i = 0; i < bins; ++i) {
+            av->sum_db[i] += db[i];
+            av->sum_sq_db[i] += (double)db[i] * db[i];
+        }
+        if (!av->sum_power) continue;
+        const float* power = av->ring_power + (size_t)f * bins;
+        for (int i = 0; i < bins; ++i) av->sum_power[i] += power[i];
+    }
+}
+
+// The exponential mode keeps a weighted mean and variance in the two sum
+// arrays (West's update, seeded by the first frame). The others add the
+// new frame to their sums and take out the one it replaces in the ring.
+static void average_update(Analyzer* an) {
+    SpectrumAverage* av = &an->average;
+    const int bins = an->fft->size / 2;
+    const double* db = an->magnitude_db;
+    for (int i = 0; i < bins; ++i) {
+        if (db[i] < av->min_db[i]) av->min_db[i] = db[i];
+    }
+
+    if (av->mode == AVERAGE_EXPONENTIAL) {
+        const double a = av->count == 0 ? 1.0 : 1.0 - exp(-an->hop_size / (an->sample_rate * av->time_constant));
+        double* mean = av->sum_db;
+        double* variance = av->sum_sq_db;
+        for (int i = 0; i < bins; ++i) {
+            double delta = db[i] - mean[i];
+            mean[i] += a * delta;
+            variance[i] = (1.0 - a) * (variance[i] + a * delta * delta);
+            av->level_db[i] = mean[i];
+            av->deviation_db[i] = sqrt(variance[i]);
+        }
+        av->count = 1;
+        return;
+    }
+
+    const int full = av->count == av->frames;
+    float* slot_db = av->ring_db + (size_t)av->ring_pos * bins;
+    for (int i = 0; i < bins; ++i) {
+        float x = (float)db[i];
+        double old = full ? slot_db[i] : 0.0;
+        av->sum_db[i] += x - old;
+        av->sum_sq_db[i] += (double)x * x - old * old;
+        slot_db[i] = x;
+    }
+    if (av->sum_power) {
+        float* slot_power = av->ring_power + (size_t)av->ring_pos * bins;
+        for (int i = 0; i < bins; ++i) {
+            float p = (float)(an->spectrum[i].real * an->spectrum[i].real + an->spectrum[i].imag * an->spectrum[i].imag);
+            av->sum_power[i] += p - (full ? slot_power[i] : 0.0);
+            slot_power[i] = p;
+        }
+    }
+    if (!full) av->count++;
+    if (++av->ring_pos == av->frames) {
+        av->ring_pos = 0;
+        average_resum(av, bins);
+    }
+
+    const double n = av->count;
+    for (int i = 0; i < bins; ++i) {
+        double mean = av->sum_db[i] / n;
+        double variance = av->sum_sq_db[i] / n - mean * mean;
+        av->deviation_db[i] = variance > 0.0 ? sqrt(variance) : 0.0;
+        av->level_db[i] = av->sum_power ? 10.0 * log10(av->sum_power[i] / n + POWER_FLOOR) : mean;
+    }
+}
+
+int analyzer_set_averaging(Analyzer* an, AverageMode mode, int frames, double time_constant) {
+    SpectrumAverage* av = &an->average;
+    if (frames < 1) frames = 1;
+    if (frames > AVERAGE_MAX_FRAMES) frames = AVERAGE_MAX_FRAMES;
+    av->mode = mode;
+    av->frames = frames;
+    av->time_constant = time_constant > 0.0 ? time_constant : DEFAULT_AVERAGE_TIME;
+    return average_layout(av, an->fft->size / 2);
+}
+
+void analyzer_reset_average(Analyzer* an) {
+    average_restart(&an->average, an->fft->size / 2);
+}
+
+double interpolate_peak(const double* values, int count, int index, double* peak_value) {
+    if (peak_value) *peak_value = values[index];
+    if (index < 1 || index >= count - 1) return 0.0;
+    double a = values[index - 1], b = values[index], c = values[index + 1];
+    double curvature = a - 2.0 * b + c;
+    if (curvature >= 0.0) return 0.0;
+    double offset = 0.5 * (a - c) / curvature;
+    if (offset < -0.5) offset = -0.5;
+    if (offset > 0.5) offset = 0.5;
+    if (peak_value) *peak_value = b - 0.25 * (a - c) * offset;
+    return offset;
+}
+
+// YIN on the frame's autocorrelation. Dividing by the window's own
+// autocorrelation undoes the Hann taper (Boersma's correction), which
+// gives the normalised difference d(lag) = 1 - r(lag) / r(0). YIN's
+// cumulative-mean normalisation then keeps lag 0's trivial minimum and
+// the ones just after it from winning, and the first dip below
+// PITCH_THRESHOLD is taken, walked down to its floor and interpolated.
+// Lags stop at a third of the window, since a Hann window needs about
+// three periods, and well short of where the circular wrap creeps in.
+static void track_pitch(Analyzer* an) {
+    const int fft_size = an->fft->size;
+    double* curve = an->pitch_curve;
+    autocorrelate(an->fft->plan, an->spectrum, an->fft_input, curve, fft_size);
+
+    an->pitch_freq = 0.0;
+    an->pitch_clarity = 0.0;
+    int min_lag = (int)(an->sample_rate / PITCH_MAX_FREQ);
+    int max_lag = fft_size / 3;
+    if (min_lag < 2) min_lag = 2;
+    if (curve[0] <= 0.0 || min_lag >= max_lag) return;
+
+    const double energy = curve[0];
+    const double* window_acf = an->fft->window_acf;
+    double sum = 0.0;
+    int lag = 0;
+    curve[0] = 1.0;
+    for (int i = 1; i <= max_lag && !lag; ++i) {
+        double d = 1.0 - curve[i] / (energy * window_acf[i]);
+        sum += d;
+        curve[i] = sum > 0.0 ? d * i / sum : 1.0;
+        if (i > min_lag && curve[i - 1] < PITCH_THRESHOLD && curve[i] >= curve[i - 1]) lag = i - 1;
+    }
+    if (!lag) return;
+
+    // The curve has a minimum here, so interpolate its negation.
+    double around[3] = { -curve[lag - 1], -curve[lag], -curve[lag + 1] };
+    double offset = interpolate_peak(around, 3, 1, NULL);
+    an->pitch_freq = an->sample_rate / (lag + offset);
+    an->pitch_clarity = curve[lag] < 0.0 ? 1.0 : 1.0 - curve[lag];
+}
+
+static void analyze_frame(Analyzer* an) {
+    const int fft_size = an->fft->size;
+    const int bins = fft_size / 2;
+    const Sint16* frame = an->history + an->history_pos;
+    const double* window = an->fft->window;
+
+    double rms = 0.0;
+    for (int i = 0; i < fft_size; ++i) rms += (double)frame[i] * (double)frame[i];
+    an->rms = sqrt(rms / fft_size);
+    an->active = an->rms > an->squelch_threshold;
+    an->frame_count++;
+
+    // Averaging sees squelched frames too, or a noise-floor measurement
+    // would never see the noise floor.
+    const int averaging = an->average.mode != AVERAGE_OFF;
+    if (an->active || averaging) {
+        an->kernels->apply_window(frame, window, an->fft_input, fft_size);
+        fft_real_forward(an->fft->plan, an->fft_input, an->spectrum);
+        an->kernels->power_to_db(an->spectrum, an->magnitude_db, bins);
+    }
+
+    if (an->active) {
+        // The DC bin is left out of the peak search and its hold, as before.
+        int peak_index = 1 + an->kernels->peak_hold_update(an->peak_hold + 1, an->magnitude_db + 1, bins - 1, PEAK_HOLD_DECAY);
+        an->peak_hold[0] *= PEAK_HOLD_DECAY;
+        an->peak_bin = peak_index;
+        double offset = interpolate_peak(an->magnitude_db, bins, peak_index, &an->peak_db);
+        an->peak_freq = (peak_index + offset) * an->sample_rate / fft_size;
+
+        // Before the pitch tracker, which reuses the spectrum as scratch.
+        if (averaging) average_update(an);
+        if (an->pitch_on) {
+            track_pitch(an);
+        } else {
+            an->pitch_freq = 0.0;
+            an->pitch_clarity = 0.0;
+        }
+    } else {
+        an->peak_bin = 0;
+        an->peak_db = -1000.0;
+        an->peak_freq = 0.0;
+        an->pitch_freq = 0.0;
+        an->pitch_clarity = 0.0;
+        an->kernels->decay(an->peak_hold, bins, PEAK_HOLD_DECAY);
+        if (averaging) average_update(an);
+    }
+}
+
+int analyzer_feed(Analyzer* an, const Sint16* samples, int count, int* frame_ready) {
+    const int fft_size = an->fft->size;
+    int take = an->hop_size - an->pending;
+    if (take > count) take = count;
+
+    // Each sample is written to both halves of the history, so the newest
+    // fft_size samples always sit contiguously at history + history_pos.
+    int pos = an->history_pos;
+    for (int i = 0; i < take; ++i) {
+        an->history[pos] = samples[i];
+        an->history[pos + fft_size] = samples[i];
+        pos = (pos + 1) & (fft_size - 1);
+    }
+    an->history_pos = pos;
+    an->pending += take;
+
+    *frame_ready = 0;
+    if (an->pending == an->hop_size) {
+        an->pending = 0;
+        analyze_frame(an);
+        *frame_ready = 1;
+    }
+    return take;
+}
+
+void freq_to_note(double frequency, char* note_buffer, size_t buffer_size) {
+    if (frequency <= 0) {
+        snprintf(note_buffer, buffer_size, "---");
+        return;
+    }
+    const char* note_names[] = {"C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"};
+    int note_num = (int)round(12 * log2(frequency / 440.0) + 69);
+    // Below C0 (16.35 Hz) the octave would go negative, as would the index.
+    if (note_num < 12) {
+        snprintf(note_buffer, buffer_size, "---");
+        return;
+    }
+    int octave = (note_num / 12) - 1;
+    int note_index = note_num % 12;
+    snprintf(note_buffer, buffer_size, "%s%d", note_names[note_index], octave);
+}
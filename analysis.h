@@ -0,0 +1,165 @@
+/*
+ * analysis.h - Spectrum analysis setup shared by the Audio Lab front ends.
+ *
+ * The FFT length is chosen at runtime. Everything that depends only on the
+ * length (the FFT plan and the Hann window table) is built the first time a
+ * size is selected and kept in a cache, so switching sizes never recomputes
+ * trig in the per-frame path.
+ *
+ * The Analyzer is a short-time Fourier transform stage. It is fed the raw
+ * capture stream in whatever blocks arrive and runs one frame every
+ * `hop_size` samples over the newest `fft_size` samples, so every hop is
+ * analysed exactly once no matter how often the display refreshes.
+ *
+ * Levels are in dB with a full-scale sine at FULL_SCALE_DB whatever the
+ * FFT length, the window's gain being folded into the cached table, so a
+ * tone reads the same at every size. The reference is where a 4096-point
+ * frame always read, which keeps ordinary levels positive.
+ *
+ * Each FFT setup and each Analyzer keeps its per-size buffers in one
+ * cache-aligned arena, laid out once when a size is selected, so the
+ * per-frame path runs without any allocation.
+ *
+ * Spectrum averaging runs on the per-frame dB levels, each mode updating
+ * in O(bins) per frame whatever its span: exponential with a time
+ * constant, a linear mean of the last N frames from running sums over a
+ * ring of past frames, or an RMS mean that sums power rather than dB.
+ * Alongside the average it keeps each bin's standard deviation of the dB
+ * level over the same span and its lowest level since the last reset,
+ * which is what a noise-floor measurement needs.
+ *
+ * The spectral peak is interpolated between bins with a parabola through
+ * the dB levels of the peak bin and its neighbours. Optionally a frame
+ * also gets a YIN-style pitch estimate, from an autocorrelation that is
+ * one more FFT of the frame's own power spectrum.
+ */
+
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <stddef.h>
+#include <SDL.h>
+#include "fft.h"
+#include "simd.h"
+#include "arena.h"
+
+#define MIN_FFT_SIZE 256
+#define MAX_FFT_SIZE 65536
+#define DEFAULT_FFT_SIZE 4096
+#define FFT_SIZE_COUNT 9    // 256, 512, ... 65536
+#define FULL_SCALE_DB 150.0 // Level of a full-scale sine; dBFS = level - FULL_SCALE_DB.
+#define PITCH_MAX_FREQ 5000.0
+#define PITCH_THRESHOLD 0.15    // YIN's absolute threshold on the normalised difference.
+#define AVERAGE_MAX_FRAMES 64
+#define DEFAULT_AVERAGE_FRAMES 16
+#define DEFAULT_AVERAGE_TIME 1.0    // Seconds.
+
+typedef struct {
+    int size;
+    FFTPlan* plan;
+    Arena arena;        // Holds the two tables below.
+    double* window;     // Hann window scaled to FULL_SCALE_DB, `size` entries.
+    double* window_acf; // Circular autocorrelation of the window, lags 0..size / 2, 1 at lag 0.
+} FFTSetup;
+
+typedef struct {
+    FFTSetup setups[FFT_SIZE_COUNT];
+} FFTSetupCache;
+
+// Returns 1 if n is a power of two between MIN_FFT_SIZE and MAX_FFT_SIZE.
+int fft_size_is_valid(int n);
+
+// Returns the setup for `size`, building it on first use. NULL on an
+// invalid size or allocation failure.
+const FFTSetup* fft_setup_get(FFTSetupCache* cache, int size);
+void fft_setup_cache_free(FFTSetupCache* cache);
+
+typedef enum {
+    AVERAGE_OFF,
+    AVERAGE_EXPONENTIAL,        // dB levels, weighted by a time constant.
+    AVERAGE_LINEAR,             // dB levels, mean of the last N frames.
+    AVERAGE_RMS,                // Power, mean of the last N frames.
+    AVERAGE_MODE_COUNT
+} AverageMode;
+
+typedef struct {
+    AverageMode mode;
+    int frames;                 // N, linear and RMS modes.
+    double time_constant;       // Seconds, exponential mode.
+
+    Arena arena;                // Per-size; holds every buffer below.
+    double* level_db;           // The averaged spectrum.
+    double* deviation_db;       // Standard deviation of each bin's dB level.
+    double* min_db;             // Lowest dB level since the last reset.
+    double* sum_db;             // Running sums of dB and dB^2 over the ring,
+    double* sum_sq_db;          // or the exponential mean and variance.
+    double* sum_power;          // RMS mode only.
+    float* ring_db;             // `frames` past frames of bins, as summed.
+    float* ring_power;          // RMS mode only.
+    int ring_pos;
+    int count;                  // Frames averaged so far, up to `frames`.
+} SpectrumAverage;
+
+typedef struct {
+    // --- Configuration ---
+    double sample_rate;
+    int hop_size;               // Samples between frames, 1..fft_size.
+    double squelch_threshold;   // Frames with RMS at or below this skip the FFT unless averaging.
+    const DSPKernels* kernels;  // Per-bin kernels for this CPU.
+    int pitch_on;               // Run the pitch tracker on active frames.
+
+    // --- Per-size state ---
+    FFTSetupCache cache;
+    const FFTSetup* fft;
+    Arena arena;                // Holds every buffer below.
+    Sint16* history;            // Mirrored ring: 2 * fft_size samples.
+    int history_pos;            // Oldest sample of the current window.
+    int pending;                // Samples received since the last frame.
+    double* fft_input;
+    Complex* spectrum;          // fft_size / 2 + 1 bins.
+    double* magnitude_db;       // fft_size / 2 bins of the latest active frame, or any while averaging.
+    double* peak_hold;          // fft_size / 2 bins.
+    double* pitch_curve;        // fft_size / 2 + 1 lags, pitch tracker scratch.
+    SpectrumAverage average;    // Updated on every frame, squelched or not.
+
+    // --- Latest frame ---
+    Uint64 frame_count;
+    double rms;
+    int active;                 // RMS was above the squelch threshold.
+    int peak_bin;
+    double peak_db;             // Both interpolated between bins.
+    double peak_freq;
+    double pitch_freq;          // 0 when unvoiced or pitch_on is off.
+    double pitch_clarity;       // 1 - YIN's difference at the pitch lag; near 1 for a clean tone.
+} Analyzer;
+
+int analyzer_init(Analyzer* an, int fft_size, int hop_size, double sample_rate);
+void analyzer_free(Analyzer* an);
+
+// Switching sizes keeps the current overlap ratio and resets peak hold.
+int analyzer_set_fft_size(Analyzer* an, int fft_size);
+void analyzer_set_hop_size(Analyzer* an, int hop_size);
+void analyzer_reset_peak_hold(Analyzer* an);
+
+// Selects an averaging mode over `frames` frames (linear and RMS, clamped
+// to 1..AVERAGE_MAX_FRAMES) or with a `time_constant` in seconds
+// (exponential), and restarts the average. Returns 0 on allocation
+// failure, leaving averaging off.
+int analyzer_set_averaging(Analyzer* an, AverageMode mode, int frames, double time_constant);
+void analyzer_reset_average(Analyzer* an);
+
+// Consumes samples up to the next hop boundary and returns how many were
+// used. When that completes a hop the frame is analysed and *frame_ready
+// is set, so callers loop until `count` samples have been consumed.
+int analyzer_feed(Analyzer* an, const Sint16* samples, int count, int* frame_ready);
+
+// Fits a parabola through values[index - 1..index + 1] and returns the
+// offset of its vertex from `index`, in -0.5..0.5, writing the vertex
+// value to *peak_value if not NULL. Edges and flat tops give 0.
+double interpolate_peak(const double* values, int count, int index, double* peak_value);
+
+// Writes the nearest equal-tempered note name (e.g. "A4"), or "---" for
+// frequencies below C0.
+void freq_to_note(double frequency, char* note_buffer, size_t buffer_size);
+
+#endif
@@ -0,0 +1,35 @@
+/*
+ * arena.c - Aligned bump allocation over a single block.
+ */
+
+#include "arena.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+size_t arena_slice_size(size_t bytes) {
+    return (bytes + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+int arena_init(Arena* arena, size_t size) {
+    arena->allocation = calloc(1, size + ARENA_ALIGN);
+    if (!arena->allocation) return 0;
+    arena->base = (unsigned char*)(((uintptr_t)arena->allocation + ARENA_ALIGN - 1) & ~(uintptr_t)(ARENA_ALIGN - 1));
+    arena->size = size;
+    arena->used = 0;
+    return 1;
+}
+
+void arena_free(Arena* arena) {
+    free(arena->allocation);
+    arena->allocation = NULL;
+    arena->base = NULL;
+    arena->size = arena->used = 0;
+}
+
+void* arena_take(Arena* arena, size_t bytes) {
+    size_t slice = arena_slice_size(bytes);
+    if (arena->used + slice > arena->size) return NULL;
+    void* p = arena->base + arena->used;
+    arena->used += slice;
+    return p;
+}
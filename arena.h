@@ -0,0 +1,37 @@
+/*
+ * arena.h - One cache-aligned block carved into a module's buffers.
+ *
+ * A module whose buffers are all sized from one configuration adds up
+ * their slice sizes, allocates them as a single zeroed block and takes
+ * the slices in order. A reconfiguration costs one allocation, the
+ * buffers sit next to each other in memory, and nothing in the per-frame
+ * path ever allocates. Every slice starts on an ARENA_ALIGN boundary,
+ * which is a cache line and the widest SIMD load the kernels make.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_ALIGN 64
+
+typedef struct {
+    void* allocation;
+    unsigned char* base;        // First ARENA_ALIGN boundary in the allocation.
+    size_t size;
+    size_t used;
+} Arena;
+
+// Bytes a slice of `bytes` occupies, padding included.
+size_t arena_slice_size(size_t bytes);
+
+// Allocates `size` zeroed bytes, which should be the sum of the
+// arena_slice_size() of every slice to be taken. Returns 0 on failure.
+int arena_init(Arena* arena, size_t size);
+void arena_free(Arena* arena);
+
+// Takes the next slice, or returns NULL if the arena was sized too small.
+void* arena_take(Arena* arena, size_t bytes);
+
+#endif
@@ -0,0 +1,506 @@
+/*
+ * bench.c - DSP micro-benchmarks for the Audio Lab.
+ *
+ * Built with `make bench`. It needs no window and no audio device: text
+ * rendering is measured against a software renderer drawing into a
+ * surface. Each benchmark doubles its iteration count until one timed run
+ * lasts at least --time seconds, then reports ns per call and samples per
+ * second. Results are printed as CSV or JSON for comparison across builds.
+ */
+
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "fft.h"
+#include "analysis.h"
+#include "multirate.h"
+#include "trigger.h"
+#include "simd.h"
+#include "oscillator.h"
+#include "siggen.h"
+#include "textcache.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define BENCH_MAX_RESULTS 256
+#define BENCH_BLOCK 2048            // Frames per generator call, as in playback.
+#define BENCH_FONT "/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf"
+
+typedef struct {
+    char group[16];
+    char name[48];
+    int size;
+    double ns_per_op;
+    double samples_per_s;
+} BenchResult;
+
+typedef struct {
+    double min_time_s;
+    const char* filter;         // Only groups containing this, if set.
+    BenchResult results[BENCH_MAX_RESULTS];
+    int count;
+} BenchRun;
+
+typedef void (*BenchFn)(void* ctx);
+
+// --- Timing ---
+
+static double now_s(void) {
+    return (double)SDL_GetPerformanceCounter() / SDL_GetPerformanceFrequency();
+}
+
+static int group_selected(const BenchRun* run, const char* group) {
+    return !run->filter || strstr(group, run->filter) != NULL;
+}
+
+// `samples` is how many audio samples (or bins) one call processes.
+static void bench(BenchRun* run, const char* group, const char* name, int size, int samples, BenchFn fn, void* ctx) {
+    if (run->count == BENCH_MAX_RESULTS) return;
+    fn(ctx);    // Warm caches and lazily built tables.
+    Uint64 iterations = 1;
+    double elapsed;
+    for (;;) {
+        double start = now_s();
+        for (Uint64 i = 0; i < iterations; ++i) fn(ctx);
+        elapsed = now_s() - start;
+        if (elapsed >= run->min_time_s || iterations >= (1ULL << 40)) break;
+        iterations *= 2;
+    }
+    BenchResult* r = &run->results[run->count++];
+    snprintf(r->group, sizeof(r->group), "%s", group);
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->size = size;
+    r->ns_per_op = elapsed * 1e9 / iterations;
+    r->samples_per_s = samples * (double)iterations / elapsed;
+    fprintf(stderr, "%-8s %-28s %6d %14.1f ns/op\n", group, name, size, r->ns_per_op);
+}
+
+// --- FFT ---
+
+typedef struct {
+    const FFTPlan* plan;
+    Complex* data;
+    const Complex* source;
+    const double* real_in;
+} FFTContext;
+
+static void run_fft_complex(void* ctx) {
+    FFTContext* c = ctx;
+    memcpy(c->data, c->source, c->plan->n * sizeof(Complex));
+    fft_forward(c->plan, c->data);
+}
+
+static void run_fft_real(void* ctx) {
+    FFTContext* c = ctx;
+    fft_real_forward(c->plan, c->real_in, c->data);
+}
+
+static void bench_fft(BenchRun* run) {
+    if (!group_selected(run, "fft")) return;
+    for (int n = MIN_FFT_SIZE; n <= MAX_FFT_SIZE; n *= 2) {
+        FFTPlan* plan = fft_plan_create(n);
+        Complex* data = malloc(n * sizeof(Complex));
+        Complex* source = malloc(n * sizeof(Complex));
+        double* real_in = malloc(n * sizeof(double));
+        if (!plan || !data || !source || !real_in) {
+            fprintf(stderr, "Out of memory in FFT benchmark\n");
+        } else {
+            for (int i = 0; i < n; ++i) {
+                real_in[i] = sin(0.1 * i) + 0.25 * sin(0.37 * i);
+                source[i].real = real_in[i];
+                source[i].imag = 0.0;
+            }
+            FFTContext c = { plan, data, source, real_in };
+            bench(run, "fft", "fft_forward", n, n, run_fft_complex, &c);
+            bench(run, "fft", "fft_real_forward", n, n, run_fft_real, &c);
+        }
+        fft_plan_destroy(plan);
+        free(data); free(source); free(real_in);
+    }
+}
+
+// --- Per-bin kernels ---
+
+typedef struct {
+    const DSPKernels* k;
+    int n;
+    const Sint16* samples;
+    const double* window;
+    double* out;
+    const Complex* spectrum;
+    double* db;
+    double* hold;
+    int sink;
+} KernelContext;
+
+static void run_window(void* ctx) {
+    KernelContext* c = ctx;
+    c->k->apply_window(c->samples, c->window, c->out, c->n * 2);
+}
+
+static void run_power_to_db(void* ctx) {
+    KernelContext* c = ctx;
+    c->k->power_to_db(c->spectrum, c->db, c->n);
+}
+
+static void run_peak_hold(void* ctx) {
+    KernelContext* c = ctx;
+    c->sink += c->k->peak_hold_update(c->hold, c->db, c->n, 0.9995);
+}
+
+// A factor of 1 costs the same and keeps repeated runs out of denormals.
+static void run_decay(void* ctx) {
+    KernelContext* c = ctx;
+    c->k->decay(c->hold, c->n, 1.0);
+}
+
+static void run_threshold_bits(void* ctx) {
+    KernelContext* c = ctx;
+    c->k->threshold_bits(c->samples, c->n * 2, 0, (Uint32*)c->out);
+}
+
+// Largest difference, in dB, between a kernel's dB conversion and
+// log10(), over magnitudes from the power floor to well past full scale.
+static double power_to_db_error(const DSPKernels* k) {
+    enum { POINTS = 8192 };
+    static Complex spectrum[POINTS];
+    static double db[POINTS];
+    for (int i = 0; i < POINTS; ++i) {
+        double magnitude = pow(10.0, -9.0 + 20.0 * i / POINTS);
+        spectrum[i].real = magnitude * cos(i);
+        spectrum[i].imag = magnitude * sin(i);
+    }
+    k->power_to_db(spectrum, db, POINTS);
+    double worst = 0.0;
+    for (int i = 0; i < POINTS; ++i) {
+        double power = spectrum[i].real * spectrum[i].real + spectrum[i].imag * spectrum[i].imag;
+        double error = fabs(db[i] - 10.0 * log10(power + 1e-18));
+        if (error > worst) worst = error;
+    }
+    return worst;
+}
+
+static void bench_kernels(BenchRun* run) {
+    if (!group_selected(run, "kernels")) return;
+    const int fft_sizes[] = { 1024, DEFAULT_FFT_SIZE, MAX_FFT_SIZE };
+    for (int s = 0; s < 3; ++s) {
+        int size = fft_sizes[s], bins = size / 2;
+        Sint16* samples = malloc(size * sizeof(Sint16));
+        double* window = malloc(size * sizeof(double));
+        double* out = malloc(size * sizeof(double));
+        Complex* spectrum = malloc(bins * sizeof(Complex));
+        double* db = malloc(bins * sizeof(double));
+        double* hold = malloc(bins * sizeof(double));
+        if (!samples || !window || !out || !spectrum || !db || !hold) {
+            fprintf(stderr, "Out of memory in kernel benchmark\n");
+        } else {
+            for (int i = 0; i < size; ++i) {
+                samples[i] = (Sint16)(8000.0 * sin(0.05 * i));
+                window[i] = 0.5 * (1.0 - cos(2.0 * M_PI * i / (size - 1)));
+            }
+            for (int i = 0; i < bins; ++i) {
+                spectrum[i].real = cos(0.3 * i) * 1000.0;
+                spectrum[i].imag = sin(0.7 * i) * 1000.0;
+                db[i] = 60.0 * sin(0.01 * i);
+                hold[i] = 0.0;
+            }
+            for (int level = 0; level < DSP_LEVEL_COUNT; ++level) {
+                const DSPKernels* k = dsp_kernels_for((DSPLevel)level);
+                if (!k) continue;
+                KernelContext c = { k, bins, samples, window, out, spectrum, db, hold, 0 };
+                char name[48];
+                snprintf(name, sizeof(name), "apply_window/%s", k->name);
+                bench(run, "kernels", name, size, size, run_window, &c);
+                snprintf(name, sizeof(name), "power_to_db/%s", k->name);
+                bench(run, "kernels", name, size, bins, run_power_to_db, &c);
+                snprintf(name, sizeof(name), "peak_hold_update/%s", k->name);
+                bench(run, "kernels", name, size, bins, run_peak_hold, &c);
+                snprintf(name, sizeof(name), "decay/%s", k->name);
+                bench(run, "kernels", name, size, bins, run_decay, &c);
+                snprintf(name, sizeof(name), "threshold_bits/%s", k->name);
+                bench(run, "kernels", name, size, size, run_threshold_bits, &c);
+            }
+        }
+        free(samples); free(window); free(out); free(spectrum); free(db); free(hold);
+    }
+    for (int level = 0; level < DSP_LEVEL_COUNT; ++level) {
+        const DSPKernels* k = dsp_kernels_for((DSPLevel)level);
+        if (k) fprintf(stderr, "power_to_db/%s differs from log10() by at most %.1e dB\n", k->name, power_to_db_error(k));
+    }
+}
+
+// --- Whole analysis frame ---
+
+typedef struct {
+    Analyzer* an;
+    const Sint16* samples;
+    int n;
+} FrameContext;
+
+// With hop == fft_size, feeding one window's worth runs exactly one frame:
+// window, FFT, dB conversion, peak hold and peak search.
+static void run_frame(void* ctx) {
+    FrameContext* c = ctx;
+    int ready;
+    for (int done = 0; done < c->n; ) done += analyzer_feed(c->an, c->samples + done, c->n - done, &ready);
+}
+
+typedef struct {
+    Multirate* mr;
+    const Sint16* samples;
+    int n;
+} MultirateContext;
+
+static void run_multirate(void* ctx) {
+    MultirateContext* c = ctx;
+    multirate_feed(c->mr, c->samples, c->n);
+}
+
+typedef struct {
+    Trigger* trigger;
+    const Sint16* samples;
+    int n;
+} TriggerContext;
+
+static void run_trigger(void* ctx) {
+    TriggerContext* c = ctx;
+    trigger_scan(c->trigger, c->samples, c->n);
+}
+
+static void bench_analysis(BenchRun* run) {
+    if (!group_selected(run, "analysis")) return;
+    for (int size = MIN_FFT_SIZE; size <= MAX_FFT_SIZE; size *= 4) {
+        Analyzer an;
+        Sint16* samples = malloc(size * sizeof(Sint16));
+        if (!samples || !analyzer_init(&an, size, size, 48000.0)) {
+            fprintf(stderr, "Out of memory in analysis benchmark\n");
+            free(samples);
+            return;
+        }
+        an.squelch_threshold = 0.0;
+        for (int i = 0; i < size; ++i) samples[i] = (Sint16)(8000.0 * sin(0.05 * i));
+        FrameContext c = { &an, samples, size };
+        bench(run, "analysis", "analyzer_frame", size, size, run_frame, &c);
+        an.pitch_on = 1;
+        bench(run, "analysis", "analyzer_frame_pitch", size, size, run_frame, &c);
+        an.pitch_on = 0;
+
+        // A frame with averaging costs the same whatever the span, so the
+        // RMS mode over the most frames is the one to watch.
+        if (analyzer_set_averaging(&an, AVERAGE_RMS, AVERAGE_MAX_FRAMES, DEFAULT_AVERAGE_TIME)) {
+            bench(run, "analysis", "analyzer_frame_rms_average", size, size, run_frame, &c);
+        }
+        analyzer_free(&an);
+        free(samples);
+    }
+
+    // The bass stages under a default analyzer at 75% overlap, per window
+    // of input. Compare with a 65536-point analyzer_frame at the same hop.
+    Multirate mr;
+    Sint16 samples[DEFAULT_FFT_SIZE];
+    if (!multirate_init(&mr, DEFAULT_MULTIRATE_STAGES, DEFAULT_FFT_SIZE, DEFAULT_FFT_SIZE / 4, 48000.0)) {
+        fprintf(stderr, "Out of memory in analysis benchmark\n");
+        return;
+    }
+    multirate_configure(&mr, DEFAULT_FFT_SIZE, DEFAULT_FFT_SIZE / 4, 0.0);
+    for (int i = 0; i < DEFAULT_FFT_SIZE; ++i) samples[i] = (Sint16)(8000.0 * sin(0.005 * i));
+    MultirateContext c = { &mr, samples, DEFAULT_FFT_SIZE };
+    bench(run, "analysis", "multirate_stages", DEFAULT_FFT_SIZE, DEFAULT_FFT_SIZE, run_multirate, &c);
+    multirate_free(&mr);
+
+    // One capture buffer of a tone through the scope trigger.
+    Trigger trigger;
+    trigger_init(&trigger, dsp_kernels_best());
+    trigger_configure(&trigger, 0, 300, TRIGGER_RISING, 0);
+    TriggerContext t = { &trigger, samples, DEFAULT_FFT_SIZE };
+    bench(run, "analysis", "trigger_scan", DEFAULT_FFT_SIZE, DEFAULT_FFT_SIZE, run_trigger, &t);
+}
+
+// --- Synthesis ---
+
+typedef struct {
+    Oscillator osc;
+    SignalGenerator* gen;
+    float block[BENCH_BLOCK];
+    Sint16 out[BENCH_BLOCK * SIGGEN_MAX_CHANNELS];
+} SynthContext;
+
+static void run_oscillator(void* ctx) {
+    SynthContext* c = ctx;
+    oscillator_render(&c->osc, c->block, BENCH_BLOCK);
+}
+
+static void run_siggen(void* ctx) {
+    SynthContext* c = ctx;
+    siggen_render(c->gen, c->out, BENCH_BLOCK);
+}
+
+static void bench_synth(BenchRun* run) {
+    if (!group_selected(run, "synth")) return;
+    static const char* wave_names[WAVE_COUNT] = { "sine", "square", "sawtooth", "triangle" };
+    static const char* signals[] = {
+        "tone:1000", "sweep:20:5000:20", "logsweep:20:20000:10", "stepped:100:10000:31:1",
+        "white", "pink", "multitone:20:20000:31"
+    };
+    Wavetables tables;
+    SynthContext* c = calloc(1, sizeof(SynthContext));
+    SignalGenerator* gen = malloc(sizeof(SignalGenerator));
+    if (!c || !gen || !wavetables_init(&tables)) {
+        fprintf(stderr, "Out of memory in synthesis benchmark\n");
+        free(c); free(gen);
+        return;
+    }
+    c->gen = gen;
+
+    for (int wave = 0; wave < WAVE_COUNT; ++wave) {
+        char name[48];
+        snprintf(name, sizeof(name), "oscillator/%s", wave_names[wave]);
+        oscillator_set(&c->osc, &tables, (WaveformType)wave, 1000.0, 48000.0);
+        bench(run, "synth", name, BENCH_BLOCK, BENCH_BLOCK, run_oscillator, c);
+    }
+
+    // One voice per signal type on mono, then the stereo default sweep to
+    // show the cost of the mix stage.
+    for (size_t s = 0; s < sizeof(signals) / sizeof(signals[0]); ++s) {
+        Voice voice;
+        siggen_parse_voice(signals[s], &voice);
+        siggen_init(gen, &tables, 48000.0, 1);
+        siggen_add_voice(gen, &voice);
+        char name[48];
+        snprintf(name, sizeof(name), "siggen/%.*s", (int)strcspn(signals[s], ":"), signals[s]);
+        bench(run, "synth", name, BENCH_BLOCK, BENCH_BLOCK, run_siggen, c);
+    }
+    Voice voice;
+    siggen_parse_voice("sweep:20:5000:20", &voice);
+    siggen_init(gen, &tables, 48000.0, 2);
+    siggen_add_voice(gen, &voice);
+    bench(run, "synth", "siggen/sweep_stereo", BENCH_BLOCK, 2 * BENCH_BLOCK, run_siggen, c);
+
+    wavetables_free(&tables);
+    free(gen);
+    free(c);
+}
+
+// --- Text ---
+
+typedef struct {
+    SDL_Renderer* renderer;
+    TextCache* cache;
+    TTF_Font* font;
+    int counter;
+} TextContext;
+
+static const SDL_Color bench_text_color = { 200, 200, 200, 255 };
+
+// What every label cost before the cache: rasterise, upload, draw, free.
+static void run_text_uncached(void* ctx) {
+    TextContext* c = ctx;
+    SDL_Surface* surface = TTF_RenderText_Blended(c->font, "FFT Size ([/]):", bench_text_color);
+    if (!surface) return;
+    SDL_Texture* texture = SDL_CreateTextureFromSurface(c->renderer, surface);
+    SDL_Rect dst = { 30, 30, surface->w, surface->h };
+    SDL_RenderCopy(c->renderer, texture, NULL, &dst);
+    SDL_DestroyTexture(texture);
+    SDL_FreeSurface(surface);
+}
+
+static void run_text_cached(void* ctx) {
+    TextContext* c = ctx;
+    text_cache_draw(c->cache, c->font, "FFT Size ([/]):", 30, 30, bench_text_color, TEXT_ALIGN_LEFT);
+}
+
+static void run_text_glyphs(void* ctx) {
+    TextContext* c = ctx;
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.1f Hz", 20.0 + (c->counter++ % 20000));
+    text_cache_draw_glyphs(c->cache, c->font, buffer, 280, 30, bench_text_color, TEXT_ALIGN_RIGHT);
+}
+
+static void bench_text(BenchRun* run, const char* font_path) {
+    if (!group_selected(run, "text")) return;
+    if (TTF_Init() != 0) {
+        fprintf(stderr, "Skipping text benchmarks: %s\n", TTF_GetError());
+        return;
+    }
+    TTF_Font* font = TTF_OpenFont(font_path, 16);
+    SDL_Surface* target = SDL_CreateRGBSurfaceWithFormat(0, 1024, 600, 32, SDL_PIXELFORMAT_ARGB8888);
+    SDL_Renderer* renderer = target ? SDL_CreateSoftwareRenderer(target) : NULL;
+    TextCache* cache = malloc(sizeof(TextCache));
+    if (!font || !renderer || !cache) {
+        fprintf(stderr, "Skipping text benchmarks: %s\n", font ? SDL_GetError() : TTF_GetError());
+    } else {
+        text_cache_init(cache, renderer);
+        TextContext c = { renderer, cache, font, 0 };
+        bench(run, "text", "ttf_render_upload", 16, 0, run_text_uncached, &c);
+        bench(run, "text", "text_cache_draw", 16, 0, run_text_cached, &c);
+        bench(run, "text", "text_cache_draw_glyphs", 16, 0, run_text_glyphs, &c);
+        text_cache_free(cache);
+    }
+    free(cache);
+    if (renderer) SDL_DestroyRenderer(renderer);
+    if (target) SDL_FreeSurface(target);
+    if (font) TTF_CloseFont(font);
+    TTF_Quit();
+}
+
+// --- Output ---
+
+static void print_results(const BenchRun* run, int json) {
+    const DSPKernels* best = dsp_kernels_best();
+    if (json) {
+        printf("{\"kernels\":\"%s\",\"min_time_s\":%g,\"results\":[", best->name, run->min_time_s);
+        for (int i = 0; i < run->count; ++i) {
+            const BenchResult* r = &run->results[i];
+            printf("%s\n{\"group\":\"%s\",\"name\":\"%s\",\"size\":%d,\"ns_per_op\":%.2f,\"samples_per_s\":%.0f}",
+                   i ? "," : "", r->group, r->name, r->size, r->ns_per_op, r->samples_per_s);
+        }
+        printf("\n]}\n");
+    } else {
+        printf("group,name,size,ns_per_op,samples_per_s\n");
+        for (int i = 0; i < run->count; ++i) {
+            const BenchResult* r = &run->results[i];
+            printf("%s,%s,%d,%.2f,%.0f\n", r->group, r->name, r->size, r->ns_per_op, r->samples_per_s);
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    BenchRun* run = calloc(1, sizeof(BenchRun));
+    const char* font_path = BENCH_FONT;
+    int json = 0;
+    if (!run) return 1;
+    run->min_time_s = 0.1;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            ++i;
+            if (strcmp(argv[i], "json") == 0) json = 1;
+            else if (strcmp(argv[i], "csv") == 0) json = 0;
+            else { fprintf(stderr, "Format must be csv or json\n"); return 1; }
+        } else if (strcmp(argv[i], "--time") == 0 && i + 1 < argc) {
+            run->min_time_s = atof(argv[++i]);
+            if (run->min_time_s <= 0.0) { fprintf(stderr, "Time must be positive\n"); return 1; }
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            run->filter = argv[++i];
+        } else if (strcmp(argv[i], "--font") == 0 && i + 1 < argc) {
+            font_path = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--format csv|json] [--time SECONDS] [--filter GROUP] [--font FILE]\n"
+                            "Groups: fft kernels analysis synth text\n", argv[0]);
+            return 1;
+        }
+    }
+
+    bench_fft(run);
+    bench_kernels(run);
+    bench_analysis(run);
+    bench_synth(run);
+    bench_text(run, font_path);
+    print_results(run, json);
+    free(run);
+    return 0;
+}
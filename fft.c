@@ -0,0 +1,115 @@
+/*
+ * fft.c - Iterative radix-2 FFT with precomputed plans.
+ */
+
+#include "fft.h"
+#include <stdlib.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static int* make_bitrev(int n) {
+    int bits = 0;
+    while ((1 << bits) < n) ++bits;
+    int* rev = malloc(n * sizeof(int));
+    if (!rev) return NULL;
+    rev[0] = 0;
+    for (int i = 1; i < n; ++i) {
+        rev[i] = (rev[i >> 1] >> 1) | ((i & 1) << (bits - 1));
+    }
+    return rev;
+}
+
+FFTPlan* fft_plan_create(int n) {
+    if (n < 2 || (n & (n - 1)) != 0) return NULL;
+    FFTPlan* plan = calloc(1, sizeof(FFTPlan));
+    if (!plan) return NULL;
+    plan->n = n;
+    while ((1 << plan->log2n) < n) ++plan->log2n;
+    plan->bitrev = make_bitrev(n);
+    plan->bitrev_half = make_bitrev(n / 2);
+    plan->twiddle = malloc((n / 2) * sizeof(Complex));
+    if (!plan->bitrev || !plan->bitrev_half || !plan->twiddle) {
+        fft_plan_destroy(plan);
+        return NULL;
+    }
+    for (int k = 0; k < n / 2; ++k) {
+        double angle = -2.0 * M_PI * k / n;
+        plan->twiddle[k].real = cos(angle);
+        plan->twiddle[k].imag = sin(angle);
+    }
+    return plan;
+}
+
+void fft_plan_destroy(FFTPlan* plan) {
+    if (!plan) return;
+    free(plan->bitrev);
+    free(plan->bitrev_half);
+    free(plan->twiddle);
+    free(plan);
+}
+
+// Transforms m points in place. `tw_stride` selects every tw_stride-th entry
+// of the plan's twiddle table, so one table serves both n and n/2 points.
+static void transform(Complex* x, int m, const int* bitrev, const Complex* twiddle, int tw_stride) {
+    for (int i = 0; i < m; ++i) {
+        int j = bitrev[i];
+        if (i < j) { Complex t = x[i]; x[i] = x[j]; x[j] = t; }
+    }
+
+    // First stage has a unit twiddle, so it is just sums and differences.
+    for (int i = 0; i + 1 < m; i += 2) {
+        Complex a = x[i], b = x[i + 1];
+        x[i].real = a.real + b.real; x[i].imag = a.imag + b.imag;
+        x[i + 1].real = a.real - b.real; x[i + 1].imag = a.imag - b.imag;
+    }
+
+    for (int len = 4; len <= m; len <<= 1) {
+        int half = len >> 1;
+        int step = (m / len) * tw_stride;
+        for (int i = 0; i < m; i += len) {
+            Complex* a = x + i;
+            Complex* b = x + i + half;
+            for (int k = 0; k < half; ++k) {
+                Complex w = twiddle[k * step];
+                double tr = w.real * b[k].real - w.imag * b[k].imag;
+                double ti = w.real * b[k].imag + w.imag * b[k].real;
+                b[k].real = a[k].real - tr; b[k].imag = a[k].imag - ti;
+                a[k].real += tr; a[k].imag += ti;
+            }
+        }
+    }
+}
+
+void fft_forward(const FFTPlan* plan, Complex* x) {
+    transform(x, plan->n, plan->bitrev, plan->twiddle, 1);
+}
+
+void fft_real_forward(const FFTPlan* plan, const double* in, Complex* out) {
+    int m = plan->n / 2;
+
+    // Pack even/odd samples as the real/imaginary parts of an m-point signal.
+    for (int i = 0; i < m; ++i) {
+        out[i].real = in[2 * i];
+        out[i].imag = in[2 * i + 1];
+    }
+    transform(out, m, plan->bitrev_half, plan->twiddle, 2);
+
+    // Split the packed spectrum Z into the even (E) and odd (O) sample
+    // spectra, then combine: X[k] = E[k] + W^k * O[k], X[m-k] = conj(E[k] - W^k * O[k]).
+    Complex z0 = out[0];
+    out[0].real = z0.real + z0.imag; out[0].imag = 0.0;
+    out[m].real = z0.real - z0.imag; out[m].imag = 0.0;
+    for (int k = 1; k <= m / 2; ++k) {
+        Complex a = out[k], b = out[m - k];
+        double er = 0.5 * (a.real + b.real), ei = 0.5 * (a.imag - b.imag);
+        double odr = 0.5 * (a.imag + b.imag), oi = -0.5 * (a.real - b.real);
+        Complex w = plan->twiddle[k];
+        double tr = w.real * odr - w.imag * oi;
+        double ti = w.real * oi + w.imag * odr;
+        out[k].real = er + tr; out[k].imag = ei + ti;
+        out[m - k].real = er - tr; out[m - k].imag = -(ei - ti);
+    }
+}
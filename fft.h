@@ -0,0 +1,34 @@
+/*
+ * fft.h - Planned, in-place FFT engine for the Audio Lab.
+ *
+ * A plan is built once per transform size and owns the twiddle table and
+ * the bit-reversal permutations, so running a transform does no trig, no
+ * recursion and no allocation.
+ */
+
+#ifndef FFT_H
+#define FFT_H
+
+typedef struct { double real, imag; } Complex;
+
+typedef struct {
+    int n;              // Transform size (power of two, >= 2).
+    int log2n;
+    int* bitrev;        // Bit-reversal permutation for n points.
+    int* bitrev_half;   // Bit-reversal permutation for n/2 points (real path).
+    Complex* twiddle;   // e^(-2*pi*i*k/n) for k < n/2.
+} FFTPlan;
+
+// Returns NULL if n is not a power of two >= 2 or allocation fails.
+FFTPlan* fft_plan_create(int n);
+void fft_plan_destroy(FFTPlan* plan);
+
+// In-place complex transform of plan->n points.
+void fft_forward(const FFTPlan* plan, Complex* x);
+
+// Real-input transform: reads plan->n samples from `in` and writes the
+// plan->n / 2 + 1 non-negative frequency bins to `out`. Uses a half-size
+// complex transform, so it costs roughly half of fft_forward().
+void fft_real_forward(const FFTPlan* plan, const double* in, Complex* out);
+
+#endif
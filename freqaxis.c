@@ -0,0 +1,73 @@
+/*
+ * freqaxis.c - Bin to pixel table for the log-frequency spectrum axis.
+ */
+
+#include "freqaxis.h"
+#include <stdlib.h>
+#include <math.h>
+
+double freq_axis_position(double freq, double max_freq, int width) {
+    double min_log_freq = log10(MIN_DISPLAY_FREQ);
+    double log_freq_range = log10(max_freq) - min_log_freq;
+    return (log10(freq) - min_log_freq) / log_freq_range * width;
+}
+
+void freq_axis_free(FreqAxis* axis) {
+    free(axis->bin_x);
+    free(axis->column_start);
+    axis->bin_x = NULL;
+    axis->column_start = NULL;
+    axis->fft_size = 0;
+    axis->bins = 0;
+}
+
+int freq_axis_update(FreqAxis* axis, int fft_size, double sample_rate, int width) {
+    return freq_axis_update_range(axis, fft_size, sample_rate, sample_rate / 2.0, width);
+}
+
+int freq_axis_update_range(FreqAxis* axis, int fft_size, double sample_rate, double max_freq, int width) {
+    if (axis->bin_x && axis->fft_size == fft_size && axis->sample_rate == sample_rate &&
+        axis->max_freq == max_freq && axis->width == width) return 1;
+    freq_axis_free(axis);
+
+    int bins = fft_size / 2;
+    float* bin_x = malloc(bins * sizeof(float));
+    int* column_start = malloc((width + 1) * sizeof(int));
+    if (!bin_x || !column_start) {
+        free(bin_x); free(column_start);
+        return 0;
+    }
+
+    double nyquist = sample_rate / 2.0;
+    bin_x[0] = -1.0f;   // DC is never drawn.
+    for (int i = 1; i < bins; ++i) {
+        bin_x[i] = (float)freq_axis_position((double)i / bins * nyquist, max_freq, width);
+    }
+
+    // bin_x rises with i, so each column owns one contiguous run of bins.
+    int bin = 1;
+    while (bin < bins && bin_x[bin] < 0.0f) ++bin;
+    for (int c = 0; c <= width; ++c) {
+        while (bin < bins && (int)bin_x[bin] < c) ++bin;
+        column_start[c] = bin;
+    }
+
+    axis->fft_size = fft_size;
+    axis->sample_rate = sample_rate;
+    axis->max_freq = max_freq;
+    axis->width = width;
+    axis->bins = bins;
+    axis->bin_x = bin_x;
+    axis->column_start = column_start;
+    return 1;
+}
+
+void freq_axis_column_max(const FreqAxis* axis, const double* values, double floor, double* out) {
+    for (int c = 0; c < axis->width; ++c) {
+        double best = floor;
+        for (int i = axis->column_start[c]; i < axis->column_start[c + 1]; ++i) {
+            if (values[i] > best) best = values[i];
+        }
+        out[c] = best;
+    }
+}
@@ -0,0 +1,47 @@
+/*
+ * freqaxis.h - Log-frequency axis for the Audio Lab spectrum display.
+ *
+ * The spectrum is drawn on a log axis from MIN_DISPLAY_FREQ to Nyquist.
+ * Where each FFT bin lands only depends on the FFT size, the sample rate
+ * and the panel width, so the mapping is built once into a table and
+ * rebuilt only when one of those changes. Bins are grouped by pixel column
+ * so a renderer can draw one value per column (the loudest bin) instead of
+ * overdrawing thousands of high bins on a few hundred pixels.
+ */
+
+#ifndef FREQAXIS_H
+#define FREQAXIS_H
+
+#define MIN_DISPLAY_FREQ 20.0
+
+typedef struct {
+    // --- Key ---
+    int fft_size;
+    double sample_rate;
+    double max_freq;            // Right edge of the axis.
+    int width;
+
+    // --- Table ---
+    int bins;                   // fft_size / 2.
+    float* bin_x;               // Pixel offset of each bin, may lie off the panel.
+    int* column_start;          // Bins [column_start[c], column_start[c + 1]) fall in column c.
+} FreqAxis;
+
+// Offset in pixels of `freq` on a log axis `width` pixels wide that ends
+// at `max_freq`.
+double freq_axis_position(double freq, double max_freq, int width);
+
+// Rebuilds the table if the key changed. Returns 0 on allocation failure,
+// leaving the axis empty.
+int freq_axis_update(FreqAxis* axis, int fft_size, double sample_rate, int width);
+
+// As above for an axis that ends at `max_freq` rather than the FFT's own
+// Nyquist, so a decimated analyzer's bins land on the full-band display.
+int freq_axis_update_range(FreqAxis* axis, int fft_size, double sample_rate, double max_freq, int width);
+void freq_axis_free(FreqAxis* axis);
+
+// Writes the largest value of each column's bins to `out[c]`, or `floor`
+// for columns that no bin falls in. `values` has axis->bins entries.
+void freq_axis_column_max(const FreqAxis* axis, const double* values, double floor, double* out);
+
+#endif
@@ -0,0 +1,353 @@
+/*
+ * headless.c - File-driven analysis on a thread pool with CSV/JSON output.
+ */
+
+#include "headless.h"
+#include "analysis.h"
+#include "wavfile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_SEGMENT_FRAMES 256  // Keeps window warm-up small next to real work.
+#define SEGMENTS_PER_JOB 4      // Extra segments even out uneven workers.
+
+typedef struct {
+    long long frame;            // 1-based frame index, 0 if nothing passed the squelch.
+    double freq;
+    double db;
+} PeakSummary;
+
+typedef struct {
+    const char* path;
+    int sample_rate;
+    long long sample_count;
+    long long frame_total;
+    int first_task;
+    int task_count;
+} FileJob;
+
+typedef struct {
+    int file;
+    long long first_frame;      // Inclusive, 1-based.
+    long long last_frame;       // Inclusive.
+    FILE* rows;                 // Formatted output, merged in task order.
+    double* max_hold;           // Per-bin maximum dB over the segment's frames.
+    PeakSummary peak;
+    int failed;
+} SegmentTask;
+
+typedef struct {
+    const HeadlessOptions* opts;
+    FileJob* files;
+    SegmentTask* tasks;
+    int task_count;
+    SDL_atomic_t next_task;
+} WorkQueue;
+
+// --- Output Formatting ---
+
+static void write_json_string(FILE* out, const char* text) {
+    fputc('"', out);
+    for (const char* c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\') fputc('\\', out);
+        fputc(*c, out);
+    }
+    fputc('"', out);
+}
+
+static void write_csv_field(FILE* out, const char* text) {
+    if (!strpbrk(text, ",\"\n")) { fputs(text, out); return; }
+    fputc('"', out);
+    for (const char* c = text; *c; ++c) {
+        if (*c == '"') fputc('"', out);
+        fputc(*c, out);
+    }
+    fputc('"', out);
+}
+
+static void write_file_header(FILE* out, const HeadlessOptions* opts, const FileJob* file) {
+    if (opts->json) {
+        fprintf(out, "{\"input\":");
+        write_json_string(out, file->path);
+        fprintf(out, ",\"sample_rate\":%d,\"fft_size\":%d,\"hop_size\":%d,\"frames\":[",
+                file->sample_rate, opts->fft_size, opts->hop_size);
+    }
+}
+
+// Time is that of the newest sample in the frame's window.
+static void write_frame(FILE* out, const HeadlessOptions* opts, const FileJob* file, const Analyzer* an, long long frame) {
+    double time_s = (double)frame * an->hop_size / an->sample_rate;
+    char note[16];
+    freq_to_note(an->active ? an->peak_freq : 0.0, note, sizeof(note));
+    const int voiced = an->pitch_freq > 0.0;
+    if (opts->json) {
+        fprintf(out, "%s\n{\"frame\":%lld,\"time_s\":%.6f,\"rms\":%.2f,", frame > 1 ? "," : "", frame, time_s, an->rms);
+        if (an->active) {
+            fprintf(out, "\"peak_hz\":%.3f,\"peak_dbfs\":%.2f,\"note\":\"%s\"", an->peak_freq, an->peak_db - FULL_SCALE_DB, note);
+        } else {
+            fprintf(out, "\"peak_hz\":null,\"peak_dbfs\":null,\"note\":null");
+        }
+        if (opts->pitch && voiced) fprintf(out, ",\"pitch_hz\":%.3f,\"clarity\":%.3f", an->pitch_freq, an->pitch_clarity);
+        else if (opts->pitch) fprintf(out, ",\"pitch_hz\":null,\"clarity\":null");
+        fputc('}', out);
+    } else {
+        if (opts->input_count > 1) { write_csv_field(out, file->path); fputc(',', out); }
+        fprintf(out, "%lld,%.6f,%.2f,", frame, time_s, an->rms);
+        if (an->active) {
+            fprintf(out, "%.3f,%.2f,%s", an->peak_freq, an->peak_db - FULL_SCALE_DB, note);
+        } else {
+            fprintf(out, ",,---");
+        }
+        if (opts->pitch && voiced) fprintf(out, ",%.3f,%.3f", an->pitch_freq, an->pitch_clarity);
+        else if (opts->pitch) fprintf(out, ",,");
+        fputc('\n', out);
+    }
+}
+
+static void write_file_footer(FILE* out, const HeadlessOptions* opts, const FileJob* file, const PeakSummary* peak) {
+    if (!opts->json) return;
+    fprintf(out, "\n],\"peak\":");
+    if (peak->frame > 0) {
+        char note[16];
+        freq_to_note(peak->freq, note, sizeof(note));
+        fprintf(out, "{\"frame\":%lld,\"time_s\":%.6f,\"peak_hz\":%.3f,\"peak_dbfs\":%.2f,\"note\":\"%s\"}}",
+                peak->frame, (double)peak->frame * opts->hop_size / file->sample_rate, peak->freq, peak->db - FULL_SCALE_DB, note);
+    } else {
+        fprintf(out, "null}");
+    }
+}
+
+static void write_peak_hold(FILE* out, const HeadlessOptions* opts, const FileJob* file, const double* max_hold) {
+    int bins = opts->fft_size / 2;
+    for (int i = 0; i < bins; ++i) {
+        if (opts->input_count > 1) { write_csv_field(out, file->path); fputc(',', out); }
+        fprintf(out, "%d,%.3f,", i, (double)i * file->sample_rate / opts->fft_size);
+        if (max_hold[i] > -1000.0) fprintf(out, "%.2f\n", max_hold[i] - FULL_SCALE_DB);
+        else fputc('\n', out);
+    }
+}
+
+// --- Segment Workers ---
+
+// Analyses frames first_frame..last_frame of one file. Reading starts on a
+// hop boundary at least one window before the first frame, so the warm-up
+// frames rebuild exactly the history a serial run would have.
+static void run_segment(const WorkQueue* queue, SegmentTask* task) {
+    const HeadlessOptions* opts = queue->opts;
+    const FileJob* file = &queue->files[task->file];
+    const int hop = opts->hop_size;
+    const int bins = opts->fft_size / 2;
+
+    long long start = task->first_frame * hop - opts->fft_size;
+    if (start < 0) start = 0;
+    start -= start % hop;
+    long long end = task->last_frame * hop;
+    long long frame = start / hop;
+
+    task->rows = tmpfile();
+    task->max_hold = malloc(bins * sizeof(double));
+    if (!task->rows || !task->max_hold) { task->failed = 1; return; }
+    for (int i = 0; i < bins; ++i) task->max_hold[i] = -1000.0;
+
+    AudioStream input;
+    if (!audio_stream_open(&input, file->path, opts->raw_sample_rate)) { task->failed = 1; return; }
+    Analyzer an;
+    if (!analyzer_init(&an, opts->fft_size, hop, file->sample_rate)) {
+        audio_stream_close(&input);
+        task->failed = 1;
+        return;
+    }
+    an.squelch_threshold = opts->squelch_threshold;
+    an.pitch_on = opts->pitch;
+    audio_stream_seek(&input, start);
+
+    long long pos = start;
+    const Sint16* block;
+    int count;
+    while (pos < end && (block = audio_stream_next(&input, &count)) != NULL) {
+        if (count > end - pos) count = (int)(end - pos);
+        for (int used = 0; used < count; ) {
+            int frame_ready;
+            used += analyzer_feed(&an, block + used, count - used, &frame_ready);
+            if (!frame_ready || ++frame < task->first_frame) continue;
+
+            write_frame(task->rows, opts, file, &an, frame);
+            if (an.active) {
+                for (int i = 0; i < bins; ++i) {
+                    if (an.magnitude_db[i] > task->max_hold[i]) task->max_hold[i] = an.magnitude_db[i];
+                }
+                if (task->peak.frame == 0 || an.peak_db > task->peak.db) {
+                    task->peak.frame = frame;
+                    task->peak.freq = an.peak_freq;
+                    task->peak.db = an.peak_db;
+                }
+            }
+        }
+        pos += count;
+    }
+    if (input.failed || pos < end || ferror(task->rows)) task->failed = 1;
+
+    analyzer_free(&an);
+    audio_stream_close(&input);
+}
+
+static int worker_main(void* data) {
+    WorkQueue* queue = data;
+    int index;
+    while ((index = SDL_AtomicAdd(&queue->next_task, 1)) < queue->task_count) {
+        run_segment(queue, &queue->tasks[index]);
+    }
+    return 0;
+}
+
+// --- Planning and Merging ---
+
+static int plan_files(const HeadlessOptions* opts, FileJob* files, long long* total_frames) {
+    *total_frames = 0;
+    for (int f = 0; f < opts->input_count; ++f) {
+        AudioStream input;
+        if (!audio_stream_open(&input, opts->input_paths[f], opts->raw_sample_rate)) return 0;
+        files[f].path = opts->input_paths[f];
+        files[f].sample_rate = input.sample_rate;
+        files[f].sample_count = input.frame_count;
+        files[f].frame_total = input.frame_count / opts->hop_size;
+        audio_stream_close(&input);
+        *total_frames += files[f].frame_total;
+    }
+    return 1;
+}
+
+// Appends a finished segment's rows to the output.
+static int copy_rows(FILE* rows, FILE* out) {
+    char buffer[1 << 16];
+    size_t n;
+    rewind(rows);
+    while ((n = fread(buffer, 1, sizeof(buffer), rows)) > 0) {
+        if (fwrite(buffer, 1, n, out) != n) return 0;
+    }
+    return !ferror(rows);
+}
+
+int run_headless(const HeadlessOptions* opts) {
+    int jobs = opts->jobs > 0 ? opts->jobs : SDL_GetCPUCount();
+    if (jobs < 1) jobs = 1;
+
+    FileJob* files = calloc(opts->input_count, sizeof(FileJob));
+    if (!files) { fprintf(stderr, "Out of memory\n"); return 1; }
+    long long total_frames;
+    if (!plan_files(opts, files, &total_frames)) { free(files); return 1; }
+
+    // One segment per file when running serially, otherwise enough
+    // segments to keep every worker busy until the end.
+    long long segment_frames = total_frames + 1;
+    if (jobs > 1) {
+        long long target = (long long)jobs * SEGMENTS_PER_JOB;
+        segment_frames = (total_frames + target - 1) / target;
+        if (segment_frames < MIN_SEGMENT_FRAMES) segment_frames = MIN_SEGMENT_FRAMES;
+    }
+    int task_count = 0;
+    for (int f = 0; f < opts->input_count; ++f) {
+        files[f].first_task = task_count;
+        files[f].task_count = (int)((files[f].frame_total + segment_frames - 1) / segment_frames);
+        if (files[f].task_count < 1) files[f].task_count = 1;
+        task_count += files[f].task_count;
+    }
+
+    SegmentTask* tasks = calloc(task_count, sizeof(SegmentTask));
+    double* merged_hold = malloc((opts->fft_size / 2) * sizeof(double));
+    if (!tasks || !merged_hold) {
+        fprintf(stderr, "Out of memory\n");
+        free(tasks); free(merged_hold); free(files);
+        return 1;
+    }
+    for (int f = 0; f < opts->input_count; ++f) {
+        for (int t = 0; t < files[f].task_count; ++t) {
+            SegmentTask* task = &tasks[files[f].first_task + t];
+            task->file = f;
+            task->first_frame = 1 + t * segment_frames;
+            task->last_frame = task->first_frame + segment_frames - 1;
+            if (task->last_frame > files[f].frame_total) task->last_frame = files[f].frame_total;
+        }
+    }
+
+    // --- Run the Pool (the calling thread is one of the workers) ---
+    WorkQueue queue = { .opts = opts, .files = files, .tasks = tasks, .task_count = task_count };
+    SDL_AtomicSet(&queue.next_task, 0);
+    int thread_count = (jobs < task_count ? jobs : task_count) - 1;
+    SDL_Thread** threads = thread_count > 0 ? calloc(thread_count, sizeof(SDL_Thread*)) : NULL;
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; threads && i < thread_count; ++i) {
+        threads[i] = SDL_CreateThread(worker_main, "analysis worker", &queue);
+    }
+    worker_main(&queue);
+    for (int i = 0; threads && i < thread_count; ++i) {
+        if (threads[i]) SDL_WaitThread(threads[i], NULL);
+    }
+    free(threads);
+
+    // --- Merge in File and Segment Order ---
+    FILE* out = opts->output_path ? fopen(opts->output_path, "w") : stdout;
+    FILE* hold_out = opts->peak_hold_path ? fopen(opts->peak_hold_path, "w") : NULL;
+    int failed = !out || (opts->peak_hold_path && !hold_out);
+    if (!out) fprintf(stderr, "Cannot write %s\n", opts->output_path);
+    if (opts->peak_hold_path && !hold_out) fprintf(stderr, "Cannot write %s\n", opts->peak_hold_path);
+
+    if (!failed) {
+        setvbuf(out, NULL, _IOFBF, 1 << 16);
+        if (opts->json && opts->input_count > 1) fputc('[', out);
+        if (!opts->json) {
+            fprintf(out, "%sframe,time_s,rms,peak_hz,peak_dbfs,note%s\n", opts->input_count > 1 ? "file," : "", opts->pitch ? ",pitch_hz,clarity" : "");
+        }
+        if (hold_out) fprintf(hold_out, "%sbin,freq_hz,max_dbfs\n", opts->input_count > 1 ? "file," : "");
+    }
+    for (int f = 0; f < opts->input_count && !failed; ++f) {
+        PeakSummary peak = {0};
+        for (int i = 0; i < opts->fft_size / 2; ++i) merged_hold[i] = -1000.0;
+        if (f > 0 && opts->json) fprintf(out, ",\n");
+        write_file_header(out, opts, &files[f]);
+        for (int t = 0; t < files[f].task_count; ++t) {
+            SegmentTask* task = &tasks[files[f].first_task + t];
+            if (task->failed || !copy_rows(task->rows, out)) { failed = 1; break; }
+            for (int i = 0; i < opts->fft_size / 2; ++i) {
+                if (task->max_hold[i] > merged_hold[i]) merged_hold[i] = task->max_hold[i];
+            }
+            if (task->peak.frame > 0 && (peak.frame == 0 || task->peak.db > peak.db)) peak = task->peak;
+        }
+        write_file_footer(out, opts, &files[f], &peak);
+        if (hold_out) write_peak_hold(hold_out, opts, &files[f], merged_hold);
+
+        char note[16];
+        freq_to_note(peak.freq, note, sizeof(note));
+        if (peak.frame > 0) {
+            fprintf(stderr, "%s: peak %.1f Hz (%s) at %.2f dBFS, %.3f s\n", files[f].path, peak.freq, note, peak.db - FULL_SCALE_DB,
+                    (double)peak.frame * opts->hop_size / files[f].sample_rate);
+        } else {
+            fprintf(stderr, "%s: no frames above squelch\n", files[f].path);
+        }
+    }
+    if (!failed && opts->json) fprintf(out, opts->input_count > 1 ? "]\n" : "\n");
+    if (out) {
+        failed |= ferror(out);
+        if (out != stdout) failed |= fclose(out) != 0;
+        else fflush(out);
+    }
+    if (hold_out) failed |= fclose(hold_out) != 0;
+    double elapsed = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+
+    double audio_s = 0.0;
+    for (int f = 0; f < opts->input_count; ++f) audio_s += (double)files[f].sample_count / files[f].sample_rate;
+    fprintf(stderr, "Analysed %.1f s of audio in %.3f s (%.0fx real time, %lld frames, %d segments on %d threads)\n",
+            audio_s, elapsed, elapsed > 0 ? audio_s / elapsed : 0.0, total_frames, task_count, thread_count + 1);
+
+    for (int t = 0; t < task_count; ++t) {
+        if (tasks[t].rows) fclose(tasks[t].rows);
+        free(tasks[t].max_hold);
+    }
+    free(tasks); free(merged_hold); free(files);
+    if (failed) {
+        fprintf(stderr, "Analysis did not complete\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,36 @@
+/*
+ * headless.h - Batch analysis of audio files without a display or device.
+ *
+ * Runs the same STFT pipeline as the live view over WAV or raw files as
+ * fast as the CPU allows, writing one row per analysis frame (peak
+ * frequency, level and note, and optionally the tracked pitch) as CSV or
+ * JSON. Levels are dBFS, as in the network stream.
+ *
+ * Work is spread over a thread pool. Each file is cut into segments of
+ * whole hops; a segment primes its window with the samples before its
+ * first frame, so every frame is bit-identical to a serial run. Workers
+ * keep their own analyzer, FFT plan and scratch buffers, and results are
+ * merged in segment order, so output never depends on the job count.
+ */
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+typedef struct {
+    const char** input_paths;
+    int input_count;
+    const char* output_path;    // NULL writes to stdout.
+    const char* peak_hold_path; // Optional per-bin maximum over each file.
+    int json;                   // 0 writes CSV.
+    int pitch;                  // Add pitch_hz and clarity to every frame.
+    int fft_size;
+    int hop_size;
+    int jobs;                   // Worker threads; 0 uses every CPU.
+    double squelch_threshold;
+    int raw_sample_rate;        // Sample rate assumed for raw PCM input.
+} HeadlessOptions;
+
+// Returns the process exit code.
+int run_headless(const HeadlessOptions* opts);
+
+#endif
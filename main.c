@@ -14,27 +14,58 @@
 #include <SDL.h>
 #include <SDL_ttf.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
+#include "analysis.h"
+#include "ringbuf.h"
+#include "headless.h"
+#include "textcache.h"
+#include "freqaxis.h"
+#include "siggen.h"
+#include "perfstats.h"
+#include "waterfall.h"
+#include "multirate.h"
+#include "trigger.h"
+#include "recorder.h"
+#include "netstream.h"
 
 // --- Constants & Enums ---
 #define SCREEN_WIDTH 1024
 #define SCREEN_HEIGHT 600
-#define SAMPLE_RATE 44100
-#define REC_BUFFER_SIZE 4096
+#define SAMPLE_RATE 44100        // Requested rate; the devices may pick another.
+#define REC_BUFFER_SIZE 4096     // Oscilloscope window and default capture block.
+#define MIN_CAPTURE_PERIOD 32
 #define PLAY_BUFFER_SIZE 2048
+#define CAPTURE_RING_SIZE (2 * MAX_FFT_SIZE)   // Per channel.
+#define MAX_CHANNELS 8
+#define SPECTRUM_DB_FLOOR (FULL_SCALE_DB - 130.0)   // Spectrum view, -130 to -40 dBFS.
+#define SPECTRUM_DB_TOP (FULL_SCALE_DB - 40.0)
+#define DEFAULT_IDLE_FPS 4        // Redraw rate while paused or squelched.
+#define SCOPE_MAX_POINTS (REC_BUFFER_SIZE > 2 * SCREEN_WIDTH ? REC_BUFFER_SIZE : 2 * SCREEN_WIDTH)
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
 typedef enum {
-    WAVE_SINE, WAVE_SQUARE, WAVE_SAWTOOTH, WAVE_TRIANGLE
-} WaveformType;
+    CHANNELS_OVERLAY, CHANNELS_STACKED
+} ChannelLayout;
 
-// --- Type Definitions ---
-typedef struct { double real, imag; } Complex;
+// Timed sections of the render loop, then of the analysis thread.
+typedef enum {
+    PERF_EVENTS, PERF_HANDOFF, PERF_BACKGROUND, PERF_SCOPE, PERF_SPECTRUM, PERF_TEXT, PERF_PRESENT, PERF_FRAME,
+    PERF_DSP_PASS, PERF_DSP_FRAME, PERF_SECTION_COUNT
+} PerfSection;
+#define PERF_DSP_FIRST PERF_DSP_PASS
+#define PERF_DSP_COUNT (PERF_SECTION_COUNT - PERF_DSP_FIRST)
+
+static const char* perf_section_names[PERF_SECTION_COUNT] = {
+    "events", "handoff", "background", "scope", "spectrum", "text", "present", "frame", "dsp_pass", "dsp_frame"
+};
 
+// --- Type Definitions ---
 typedef struct {
     double x_pos;
     double db;
@@ -44,13 +75,51 @@ typedef struct {
 typedef struct {
     int is_on;
     int is_paused;
-    WaveformType wave_type;
-    double sweep_time;
-    int sweep_up;
-    double phase;
-    double current_freq;
+    WaveformType wave_type;             // Applied to every tonal voice.
 } ToneGenerator;
 
+// Analysis settings are written by the UI thread and picked up by the
+// analysis thread on its next pass.
+typedef struct {
+    SDL_atomic_t fft_size;
+    SDL_atomic_t hop_size;
+    SDL_atomic_t squelch;
+    SDL_atomic_t trigger_mode;
+    SDL_atomic_t trigger_slope;
+    SDL_atomic_t trigger_level;
+    SDL_atomic_t auto_timebase_on;
+    SDL_atomic_t peak_reset_count;
+    SDL_atomic_t waterfall_on;
+    SDL_atomic_t pitch_on;
+    SDL_atomic_t average_mode;
+} AnalysisSettings;
+
+// Everything the renderer needs from one analysis pass.
+typedef struct {
+    Uint64 frame_count;
+    int fft_size;
+    int hop_size;
+    int trigger_offset;
+    int scope_display_samples;
+    PeakMarker peak_marker;             // Follows channel 0.
+    Uint32 capture_stamp_us;            // When the newest analysed block arrived.
+    int channels;
+    Sint16 scope[MAX_CHANNELS][REC_BUFFER_SIZE];
+    double peak_hold[MAX_CHANNELS][MAX_FFT_SIZE / 2];
+    int low_columns;                    // Leading spectrum columns taken from low_peak_hold.
+    double low_peak_hold[MAX_CHANNELS][SCREEN_WIDTH];
+    int average_on;                     // Channel 0's average, per spectrum column.
+    double average_columns[SCREEN_WIDTH];
+    double deviation_columns[SCREEN_WIDTH];
+    double min_columns[SCREEN_WIDTH];
+    int active;                         // Some channel is above the squelch.
+    PerfHistogram dsp_perf[PERF_DSP_COUNT];     // Last complete window.
+} DisplayFrame;
+
+#define DISPLAY_FRAME_FRESH 4
+#define UI_WAKE_FRAME 0                 // frame_event codes.
+#define UI_WAKE_ROWS 1
+
 
 // --- Global App State ---
 struct {
@@ -59,20 +128,114 @@ struct {
     TTF_Font* font_large;
     TTF_Font* font_medium;
     TTF_Font* font_small;
+    TextCache text_cache;
+    SDL_Texture* background;            // Panels and graticules, see update_background().
+    int background_dirty;
+    SDL_Point scope_points[SCOPE_MAX_POINTS];        // Trace geometry, rebuilt per frame.
+    SDL_Rect peak_hold_marks[SCREEN_WIDTH];
+    SDL_Point average_points[SCREEN_WIDTH];
+    SDL_Rect deviation_bands[SCREEN_WIDTH];
+    FreqAxis spectrum_axis;
+    double column_peak_hold[SCREEN_WIDTH];
+    Waterfall waterfall;
+    int waterfall_on;
+    int pitch_on;                       // Name the tracked pitch rather than the spectral peak.
+    AverageMode average_mode;
+    int average_frames;                 // Fixed at startup, read by the analysis thread.
+    double average_time;
     int is_running;
     int is_paused;
-    int trigger_lock_on;
+    TriggerMode trigger_mode;
+    TriggerSlope trigger_slope;
+    int trigger_level;
+    int trigger_hysteresis;             // Fixed at startup, read by the analysis thread.
+    double trigger_holdoff_ms;
     int auto_timebase_on;
     SDL_AudioDeviceID rec_device;
     SDL_AudioDeviceID play_device;
-    Sint16 rec_buffer[REC_BUFFER_SIZE];
-    double peak_hold_magnitudes[REC_BUFFER_SIZE / 2];
-    PeakMarker peak_marker;
+    SDL_AudioSpec capture_spec;         // As obtained from the device.
+    int capture_period;                 // Requested frames per capture callback.
+    SDL_atomic_t capture_stamp_us;      // clock_us() of the latest capture callback.
+    double ticks_per_us;
+    double sample_rate;                 // Capture rate, used for all analysis maths.
+    double play_rate;
+    int play_channels;
+    int play_period;                    // Frames per playback callback.
+    Uint32 capture_last_us;             // Private to each callback, for late detection.
+    Uint32 playback_last_us;
+    SDL_atomic_t capture_late;          // Callbacks more than 1.5 periods apart.
+    SDL_atomic_t playback_late;
+    int channels;                       // Analysed channels, 1..MAX_CHANNELS.
+    int bass_octaves;                   // Multirate stages below the main analyzer.
+    ChannelLayout channel_layout;
+    SampleRing capture_rings[MAX_CHANNELS];     // Written only by recording_callback.
+    Recorder recorder;                  // Tapped by recording_callback, see recorder.h.
+    const char* record_path;            // --record FILE, used by the first recording only.
+    const char* stream_targets[NETSTREAM_MAX_TARGETS];  // --stream HOST:PORT.
+    int stream_target_count;
+    int stream_bits;
+    int stream_ttl;
+    SDL_sem* capture_ready;             // Posted once per captured block.
+    RowRing waterfall_rows;             // One row per analysed hop, analysis thread to UI.
+    AnalysisSettings settings;
     double squelch_threshold;
     double visual_gain;
     double scope_gain;
+
+    // --- Owned by the analysis thread ---
+    SDL_Thread* analysis_thread;
+    SDL_atomic_t analysis_running;
+    Analyzer analyzers[MAX_CHANNELS];
+    Multirate multirate[MAX_CHANNELS];
+    Sint16 rec_buffers[MAX_CHANNELS][REC_BUFFER_SIZE];  // Most recent samples, oldest first.
+    Sint16 scope_view[MAX_CHANNELS][REC_BUFFER_SIZE];   // rec_buffers as of the trace on show.
+    int scope_view_samples;             // scope_display_samples as of the trace on show.
+    Trigger trigger;                    // Fed channel 0's stream.
+    NetStream stream;                   // Publishes every channel's frames.
+    int trigger_offset;
+    PeakMarker peak_marker;
     int scope_display_samples;
+    FreqAxis marker_axis;
+    double waterfall_columns[SCREEN_WIDTH];
+    Uint32 frame_stamp_us;              // Capture stamp of the newest analysed block.
+    PerfHistogram dsp_perf[PERF_DSP_COUNT];         // Window being filled.
+    PerfHistogram dsp_perf_done[PERF_DSP_COUNT];    // Last complete window.
+    Uint32 dsp_window_start_us;
+
+    // --- Triple-buffered hand-off to the renderer ---
+    DisplayFrame* display_frames;       // Three slots.
+    SDL_atomic_t display_middle;        // Slot index, plus DISPLAY_FRAME_FRESH.
+    int display_back;                   // Written by the analysis thread.
+    int display_front;                  // Read by the UI thread.
+    Uint32 frame_event;                 // Pushed after a publish to wake the UI thread.
+    SDL_atomic_t frame_event_pending;   // One is queued and not yet drawn.
+    SDL_atomic_t latest_active;         // The newest published frame's `active`.
+    SDL_atomic_t rows_event_pending;    // A filling waterfall ring has woken the UI.
     ToneGenerator generator;
+    Wavetables wavetables;
+    SignalGenerator signal;             // Owned by playback_callback once the device runs.
+    WaveformType signal_wave;           // Waveform last applied to the signal voices.
+
+    // --- Frame scheduling (UI thread) ---
+    int target_fps;                     // 0 paces redraws by vsync.
+    int idle_fps;
+    int ui_dirty;                       // Input or a window change since the last redraw.
+    Uint32 last_redraw_ms;
+
+    // --- Latency report (UI thread) ---
+    Uint64 last_presented_frame;
+    double latency_ms;                  // Smoothed input-to-present latency.
+    double latency_max_ms;
+    double latency_sum_ms;
+    Uint64 latency_samples;
+
+    // --- Instrumentation (UI thread) ---
+    int perf_overlay_on;
+    PerfHistogram perf[PERF_DSP_FIRST];             // Window being filled.
+    PerfHistogram perf_shown[PERF_SECTION_COUNT];   // Last complete window, both threads.
+    Uint32 perf_window_start_us;
+    Uint64 perf_start_ticks;            // For the stats file's time column, which must not wrap.
+    FILE* stats_file;
     SDL_Rect generator_button_rect;
     SDL_Rect scope_panel_rect;
     SDL_Rect spectrum_panel_rect;
@@ -80,13 +243,30 @@ struct {
 } AppState = {
     .is_running = 1,
     .is_paused = 0,
-    .trigger_lock_on = 1,
+    .trigger_mode = TRIGGER_AUTO,
+    .trigger_slope = TRIGGER_RISING,
+    .trigger_hysteresis = 300,
     .auto_timebase_on = 1,
     .squelch_threshold = 500.0,
     .visual_gain = 1.0,
     .scope_gain = 1.0,
+    .channels = 1,
+    .bass_octaves = DEFAULT_MULTIRATE_STAGES,
+    .average_frames = DEFAULT_AVERAGE_FRAMES,
+    .average_time = DEFAULT_AVERAGE_TIME,
+    .stream_bits = 16,
+    .stream_ttl = 1,
+    .idle_fps = DEFAULT_IDLE_FPS,
+    .frame_event = (Uint32)-1,
+    .capture_period = REC_BUFFER_SIZE,
+    .channel_layout = CHANNELS_OVERLAY,
+    .sample_rate = SAMPLE_RATE,
+    .play_rate = SAMPLE_RATE,
+    .play_channels = 1,
+    .background_dirty = 1,
     .scope_display_samples = 2048,
-    .generator = { .is_on = 0, .is_paused = 0, .wave_type = WAVE_SINE, .sweep_time = 0.0, .sweep_up = 1, .phase = 0.0, .current_freq = 20.0 },
+    .scope_view_samples = 2048,
+    .generator = { .is_on = 0, .is_paused = 0, .wave_type = WAVE_SINE },
     .generator_button_rect = { SCREEN_WIDTH - 160, SCREEN_HEIGHT - 60, 150, 50 },
     .scope_panel_rect = {10, 10, 1004, 285},
     .spectrum_panel_rect = {10, 305, 1004, 285},
@@ -95,58 +275,348 @@ struct {
 
 // --- Forward Declarations ---
 void recording_callback(void* userdata, Uint8* stream, int len);
+SDL_AudioDeviceID open_capture_device(int rate, int channels, int period);
+Uint32 clock_us();
+FILE* report_stream();
+void record_latency(const DisplayFrame* frame);
+void perf_mark(PerfHistogram* hist, Uint64* mark);
+void perf_end_frame(const DisplayFrame* frame);
+void write_stats_header();
+void count_late_callback(Uint32* last_us, int period, int rate, SDL_atomic_t* late);
+int capture_dropped();
+void draw_perf_overlay();
+SDL_Rect waterfall_rect();
+void push_waterfall_row();
 void playback_callback(void* userdata, Uint8* stream, int len);
-void fft(Complex* x, int n);
-void draw_text(const char* text, TTF_Font* font, int x, int y, SDL_Color color, int align_right);
-void freq_to_note(double frequency, char* note_buffer, size_t buffer_size);
+void draw_text(const char* text, TTF_Font* font, int x, int y, SDL_Color color, TextAlign align);
+void draw_value(const char* text, TTF_Font* font, int x, int y, SDL_Color color, TextAlign align);
 void draw_panel(const char* title, SDL_Rect rect);
 void draw_scope_graticule();
 void draw_spectrum_graticule();
-void reset_peak_hold();
+void draw_background();
+int build_scope_trace(const DisplayFrame* frame, int channel, SDL_Rect rect, SDL_Point* points);
+int build_peak_hold_marks(const DisplayFrame* frame, int channel, SDL_Rect rect, SDL_Rect* marks);
+void draw_average(const DisplayFrame* frame, SDL_Rect lane);
+SDL_Rect channel_lane(SDL_Rect panel, int channel, int channels);
+SDL_Color channel_color(int channel, int channels, SDL_Color mono);
+void update_background();
+int analysis_thread(void* data);
+void process_capture();
+void on_analysis_frame();
+void publish_display_frame();
+void wake_ui(SDL_atomic_t* pending, int code);
+const DisplayFrame* latest_display_frame();
+Uint32 redraw_wait_ms();
+void publish_analysis_settings();
+void request_fft_size(int size);
+void cycle_overlap();
+void toggle_recording();
 
 
 // --- Main Function ---
 int main(int argc, char* argv[]) {
+    int fft_size = DEFAULT_FFT_SIZE;
+    int hop_size = 0;
+    int headless = 0;
+    HeadlessOptions batch = { .squelch_threshold = AppState.squelch_threshold, .raw_sample_rate = SAMPLE_RATE };
+    Voice voices[SIGGEN_MAX_VOICES];
+    int voice_count = 0;
+    const char** inputs = malloc(argc * sizeof(const char*));
+    if (!inputs) return 1;
+    batch.input_paths = inputs;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--fft-size") == 0 && i + 1 < argc) {
+            fft_size = atoi(argv[++i]);
+            if (!fft_size_is_valid(fft_size)) {
+                fprintf(stderr, "FFT size must be a power of two from %d to %d\n", MIN_FFT_SIZE, MAX_FFT_SIZE);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--hop") == 0 && i + 1 < argc) {
+            hop_size = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--channels") == 0 && i + 1 < argc) {
+            AppState.channels = atoi(argv[++i]);
+            if (AppState.channels < 1 || AppState.channels > MAX_CHANNELS) {
+                fprintf(stderr, "Channel count must be from 1 to %d\n", MAX_CHANNELS);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--period") == 0 && i + 1 < argc) {
+            AppState.capture_period = atoi(argv[++i]);
+            int p = AppState.capture_period;
+            if (p < MIN_CAPTURE_PERIOD || p > REC_BUFFER_SIZE || (p & (p - 1)) != 0) {
+                fprintf(stderr, "Capture period must be a power of two from %d to %d frames\n", MIN_CAPTURE_PERIOD, REC_BUFFER_SIZE);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--bass-octaves") == 0 && i + 1 < argc) {
+            AppState.bass_octaves = atoi(argv[++i]);
+            if (AppState.bass_octaves < 0 || AppState.bass_octaves > MULTIRATE_MAX_STAGES) {
+                fprintf(stderr, "Bass octaves must be from 0 to %d\n", MULTIRATE_MAX_STAGES);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--trigger-hysteresis") == 0 && i + 1 < argc) {
+            AppState.trigger_hysteresis = atoi(argv[++i]);
+            if (AppState.trigger_hysteresis < 0 || AppState.trigger_hysteresis > 16000) {
+                fprintf(stderr, "Trigger hysteresis must be from 0 to 16000\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--trigger-holdoff") == 0 && i + 1 < argc) {
+            AppState.trigger_holdoff_ms = atof(argv[++i]);
+            if (AppState.trigger_holdoff_ms < 0.0) {
+                fprintf(stderr, "Trigger holdoff must not be negative\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--average") == 0 && i + 1 < argc) {
+            ++i;
+            if (strcmp(argv[i], "exp") == 0) AppState.average_mode = AVERAGE_EXPONENTIAL;
+            else if (strcmp(argv[i], "linear") == 0) AppState.average_mode = AVERAGE_LINEAR;
+            else if (strcmp(argv[i], "rms") == 0) AppState.average_mode = AVERAGE_RMS;
+            else { fprintf(stderr, "Average must be exp, linear or rms\n"); return 1; }
+        } else if (strcmp(argv[i], "--average-frames") == 0 && i + 1 < argc) {
+            AppState.average_frames = atoi(argv[++i]);
+            if (AppState.average_frames < 1 || AppState.average_frames > AVERAGE_MAX_FRAMES) {
+                fprintf(stderr, "Average frames must be from 1 to %d\n", AVERAGE_MAX_FRAMES);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--average-time") == 0 && i + 1 < argc) {
+            AppState.average_time = atof(argv[++i]);
+            if (AppState.average_time <= 0.0) {
+                fprintf(stderr, "Average time must be positive\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            AppState.target_fps = atoi(argv[++i]);
+            if (AppState.target_fps < 1 || AppState.target_fps > 1000) {
+                fprintf(stderr, "Frame rate must be from 1 to 1000\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--idle-fps") == 0 && i + 1 < argc) {
+            AppState.idle_fps = atoi(argv[++i]);
+            if (AppState.idle_fps < 1 || AppState.idle_fps > 60) {
+                fprintf(stderr, "Idle frame rate must be from 1 to 60\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            AppState.record_path = argv[++i];
+        } else if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc) {
+            if (AppState.stream_target_count == NETSTREAM_MAX_TARGETS) {
+                fprintf(stderr, "At most %d --stream targets are supported\n", NETSTREAM_MAX_TARGETS);
+                return 1;
+            }
+            AppState.stream_targets[AppState.stream_target_count++] = argv[++i];
+        } else if (strcmp(argv[i], "--stream-bits") == 0 && i + 1 < argc) {
+            AppState.stream_bits = atoi(argv[++i]);
+            if (AppState.stream_bits != 8 && AppState.stream_bits != 16) {
+                fprintf(stderr, "Stream bits must be 8 or 16\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--stream-ttl") == 0 && i + 1 < argc) {
+            AppState.stream_ttl = atoi(argv[++i]);
+            if (AppState.stream_ttl < 0 || AppState.stream_ttl > 255) {
+                fprintf(stderr, "Stream TTL must be from 0 to 255\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--signal") == 0 && i + 1 < argc) {
+            ++i;
+            if (voice_count == SIGGEN_MAX_VOICES) {
+                fprintf(stderr, "At most %d --signal voices are supported\n", SIGGEN_MAX_VOICES);
+                return 1;
+            }
+            if (!siggen_parse_voice(argv[i], &voices[voice_count])) {
+                fprintf(stderr, "Bad signal spec '%s'\n", argv[i]);
+                return 1;
+            }
+            ++voice_count;
+        } else if (strcmp(argv[i], "--out-channels") == 0 && i + 1 < argc) {
+            AppState.play_channels = atoi(argv[++i]);
+            if (AppState.play_channels < 1 || AppState.play_channels > SIGGEN_MAX_CHANNELS) {
+                fprintf(stderr, "Output channel count must be from 1 to %d\n", SIGGEN_MAX_CHANNELS);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+            ++i;
+            AppState.stats_file = strcmp(argv[i], "-") == 0 ? stdout : fopen(argv[i], "w");
+            if (!AppState.stats_file) {
+                fprintf(stderr, "Could not open stats file '%s'\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            headless = 1;
+        } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            inputs[batch.input_count++] = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            batch.output_path = argv[++i];
+        } else if (strcmp(argv[i], "--peak-hold") == 0 && i + 1 < argc) {
+            batch.peak_hold_path = argv[++i];
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            batch.jobs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            ++i;
+            if (strcmp(argv[i], "json") == 0) batch.json = 1;
+            else if (strcmp(argv[i], "csv") == 0) batch.json = 0;
+            else { fprintf(stderr, "Format must be csv or json\n"); return 1; }
+        } else if (strcmp(argv[i], "--pitch") == 0) {
+            batch.pitch = AppState.pitch_on = 1;
+        } else if (strcmp(argv[i], "--squelch") == 0 && i + 1 < argc) {
+            batch.squelch_threshold = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            batch.raw_sample_rate = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--fft-size N] [--hop N] [--rate HZ] [--channels N] [--period N]\n"
+                            "          [--bass-octaves N] [--pitch] [--signal SPEC...]\n"
+                            "          [--average exp|linear|rms] [--average-frames N] [--average-time S]\n"
+                            "          [--out-channels N] [--stats FILE|-]\n"
+                            "          [--trigger-hysteresis N] [--trigger-holdoff MS] [--record FILE]\n"
+                            "          [--stream HOST:PORT...] [--stream-bits 8|16] [--stream-ttl N]\n"
+                            "          [--fps N] [--idle-fps N]\n"
+                            "       %s --headless --input FILE [--input FILE...] [--output FILE]\n"
+                            "          [--format csv|json] [--peak-hold FILE] [--jobs N] [--pitch]\n"
+                            "          [--squelch N] [--rate HZ] [--fft-size N] [--hop N]\n", argv[0], argv[0]);
+            fprintf(stderr, "Signal specs: TYPE[:ARGS][@CH[,CH...]][=DBFS] with TYPE one of\n"
+                            "  tone:HZ  sweep:FROM:TO:SECONDS  logsweep:FROM:TO:SECONDS\n"
+                            "  stepped:FROM:TO:STEPS:SECONDS  white  pink  multitone:FROM:TO:TONES\n");
+            return 1;
+        }
+    }
+    if (hop_size == 0) hop_size = fft_size / 4;
+    if (hop_size < 1 || hop_size > fft_size) {
+        fprintf(stderr, "Hop size must be from 1 to the FFT size\n");
+        return 1;
+    }
+
+    // --- Headless Batch Mode (no video, fonts or audio devices) ---
+    if (headless) {
+        if (batch.input_count == 0) { fprintf(stderr, "--headless needs --input FILE\n"); return 1; }
+        if (batch.raw_sample_rate <= 0) { fprintf(stderr, "Sample rate must be positive\n"); return 1; }
+        batch.fft_size = fft_size;
+        batch.hop_size = hop_size;
+        int status = run_headless(&batch);
+        free(inputs);
+        return status;
+    }
+    if (batch.input_count > 0) {
+        fprintf(stderr, "--input is only used with --headless\n");
+        return 1;
+    }
+    if (batch.raw_sample_rate <= 0) { fprintf(stderr, "Sample rate must be positive\n"); return 1; }
+    free(inputs);
+
     // --- Initialization ---
     SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO);
     TTF_Init();
     AppState.window = SDL_CreateWindow("Audio Lab Professional", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
-    AppState.renderer = SDL_CreateRenderer(AppState.window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    // A fixed --fps paces the loop itself, so it takes the renderer off vsync.
+    AppState.renderer = SDL_CreateRenderer(AppState.window, -1, SDL_RENDERER_ACCELERATED | (AppState.target_fps > 0 ? 0 : SDL_RENDERER_PRESENTVSYNC));
+    AppState.frame_event = SDL_RegisterEvents(1);
     AppState.font_large = TTF_OpenFont("/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf", 24);
     AppState.font_medium = TTF_OpenFont("/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf", 16);
     AppState.font_small = TTF_OpenFont("/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf", 12);
     if (!AppState.font_large || !AppState.font_medium || !AppState.font_small) return 1;
-
-    reset_peak_hold();
+    text_cache_init(&AppState.text_cache, AppState.renderer);
+    if (!row_ring_init(&AppState.waterfall_rows, AppState.spectrum_panel_rect.w, WATERFALL_RING_ROWS)) return 1;
+    waterfall_init(&AppState.waterfall, AppState.renderer, AppState.spectrum_panel_rect.w, waterfall_rect().h);
+    for (int c = 0; c < AppState.channels; ++c) {
+        if (!sample_ring_init(&AppState.capture_rings[c], CAPTURE_RING_SIZE)) return 1;
+    }
 
     // --- Audio Device Setup ---
-    SDL_AudioSpec want, have;
-    SDL_zero(want);
-    want.freq = SAMPLE_RATE; want.format = AUDIO_S16SYS; want.channels = 1;
-    want.samples = REC_BUFFER_SIZE; want.callback = recording_callback;
-    AppState.rec_device = SDL_OpenAudioDevice(NULL, 1, &want, &have, 0);
-    if (AppState.rec_device > 0) SDL_PauseAudioDevice(AppState.rec_device, 0);
+    // Both devices run at whatever rate they report back; the analyzer and
+    // the generator are set up from the obtained specs, not the requested one.
+    AppState.ticks_per_us = SDL_GetPerformanceFrequency() / 1e6;
+    AppState.rec_device = open_capture_device(batch.raw_sample_rate, AppState.channels, AppState.capture_period);
+    if (AppState.rec_device > 0) AppState.sample_rate = AppState.capture_spec.freq;
 
+    if (!wavetables_init(&AppState.wavetables)) return 1;
+    SDL_AudioSpec want, have;
     SDL_zero(want);
-    want.freq = SAMPLE_RATE; want.format = AUDIO_S16SYS; want.channels = 1;
+    want.freq = batch.raw_sample_rate; want.format = AUDIO_S16SYS; want.channels = AppState.play_channels;
     want.samples = PLAY_BUFFER_SIZE; want.callback = playback_callback;
-    AppState.play_device = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
-    if (AppState.play_device > 0) SDL_PauseAudioDevice(AppState.play_device, 1);
+    AppState.play_device = SDL_OpenAudioDevice(NULL, 0, &want, &have, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+    if (AppState.play_device > 0) {
+        AppState.play_rate = have.freq;
+        AppState.play_period = have.samples;
+    }
+
+    // Without --signal the generator plays the classic 20 Hz - 5 kHz sweep.
+    siggen_init(&AppState.signal, &AppState.wavetables, AppState.play_rate, AppState.play_channels);
+    if (voice_count == 0) {
+        siggen_parse_voice("sweep:20:5000:20", &voices[0]);
+        voice_count = 1;
+    }
+    for (int v = 0; v < voice_count; ++v) siggen_add_voice(&AppState.signal, &voices[v]);
+    AppState.signal_wave = AppState.generator.wave_type;
+    siggen_set_wave(&AppState.signal, AppState.signal_wave);
+
+    for (int c = 0; c < AppState.channels; ++c) {
+        if (!analyzer_init(&AppState.analyzers[c], fft_size, hop_size, AppState.sample_rate)) return 1;
+        if (!multirate_init(&AppState.multirate[c], AppState.bass_octaves, fft_size, hop_size, AppState.sample_rate)) return 1;
+    }
+    trigger_init(&AppState.trigger, dsp_kernels_best());
+    if (AppState.stream_target_count > 0) {
+        if (!netstream_open(&AppState.stream, AppState.stream_bits, AppState.stream_ttl)) return 1;
+        for (int t = 0; t < AppState.stream_target_count; ++t) {
+            if (!netstream_add_target(&AppState.stream, AppState.stream_targets[t])) return 1;
+        }
+    }
+    AppState.display_frames = calloc(3, sizeof(DisplayFrame));
+    AppState.capture_ready = SDL_CreateSemaphore(0);
+    if (!AppState.display_frames || !AppState.capture_ready) return 1;
+    AppState.display_front = 0;
+    AppState.display_back = 2;
+    SDL_AtomicSet(&AppState.display_middle, 1);
+    SDL_AtomicSet(&AppState.settings.fft_size, fft_size);
+    SDL_AtomicSet(&AppState.settings.hop_size, hop_size);
+    publish_analysis_settings();
+    publish_display_frame();
+    AppState.perf_start_ticks = SDL_GetPerformanceCounter();
+    AppState.perf_window_start_us = AppState.dsp_window_start_us = clock_us();
+    if (AppState.stats_file) write_stats_header();
 
-    int trigger_offset = 0;
+    SDL_AtomicSet(&AppState.analysis_running, 1);
+    AppState.analysis_thread = SDL_CreateThread(analysis_thread, "analysis", NULL);
+    if (!AppState.analysis_thread) return 1;
+    if (AppState.record_path) toggle_recording();
+    if (AppState.rec_device > 0) SDL_PauseAudioDevice(AppState.rec_device, 0);
+    if (AppState.play_device > 0) SDL_PauseAudioDevice(AppState.play_device, 1);
 
     // --- Main Loop ---
     while (AppState.is_running) {
-        // --- Event Handling ---
+        // Sleeps until input arrives, the analysis thread publishes or the
+        // next redraw falls due, so the frame timings below leave out idling.
         SDL_Event e;
-        while (SDL_PollEvent(&e)) {
+        int have_event = SDL_WaitEventTimeout(&e, (int)redraw_wait_ms());
+        Uint64 frame_start = SDL_GetPerformanceCounter();
+        Uint64 mark = frame_start;
+        if (recorder_is_active(&AppState.recorder) && SDL_AtomicGet(&AppState.recorder.failed)) toggle_recording();
+
+        // --- Event Handling ---
+        for (; have_event; have_event = SDL_PollEvent(&e)) {
+            if (e.type == AppState.frame_event) {
+                if (e.user.code == UI_WAKE_ROWS) SDL_AtomicSet(&AppState.rows_event_pending, 0);
+                continue;
+            }
+            if (e.type != SDL_MOUSEMOTION) AppState.ui_dirty = 1;
             if (e.type == SDL_QUIT) AppState.is_running = 0;
+            if (e.type == SDL_RENDER_TARGETS_RESET || e.type == SDL_RENDER_DEVICE_RESET) {
+                AppState.background_dirty = 1;
+                text_cache_flush(&AppState.text_cache);
+            }
+            if (e.type == SDL_RENDER_DEVICE_RESET) {
+                // Every texture is lost with the device, so update_background()
+                // must create a new one rather than render into the old one.
+                if (AppState.background) SDL_DestroyTexture(AppState.background);
+                AppState.background = NULL;
+                waterfall_free(&AppState.waterfall);
+                waterfall_init(&AppState.waterfall, AppState.renderer, AppState.spectrum_panel_rect.w, waterfall_rect().h);
+            }
+            if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) AppState.background_dirty = 1;
             if (e.type == SDL_KEYDOWN) {
                 switch (e.key.keysym.sym) {
                     case SDLK_p: AppState.is_paused = !AppState.is_paused; break;
                     case SDLK_SPACE: AppState.generator.is_paused = !AppState.generator.is_paused; break;
-                    case SDLK_r: reset_peak_hold(); break;
-                    case SDLK_t: AppState.trigger_lock_on = !AppState.trigger_lock_on; break;
+                    case SDLK_r: SDL_AtomicIncRef(&AppState.settings.peak_reset_count); break;
+                    case SDLK_t: AppState.trigger_mode = (AppState.trigger_mode + 1) % TRIGGER_MODE_COUNT; break;
+                    case SDLK_e: AppState.trigger_slope = AppState.trigger_slope == TRIGGER_RISING ? TRIGGER_FALLING : TRIGGER_RISING; break;
+                    case SDLK_PERIOD: AppState.trigger_level += 512; if (AppState.trigger_level > 32000) AppState.trigger_level = 32000; break;
+                    case SDLK_COMMA: AppState.trigger_level -= 512; if (AppState.trigger_level < -32000) AppState.trigger_level = -32000; break;
                     case SDLK_a: AppState.auto_timebase_on = !AppState.auto_timebase_on; break;
                     case SDLK_w: AppState.scope_gain += 0.2; break;
                     case SDLK_s: AppState.scope_gain -= 0.2; if (AppState.scope_gain < 0.1) AppState.scope_gain = 0.1; break;
@@ -158,130 +628,91 @@ int main(int argc, char* argv[]) {
                     case SDLK_2: AppState.generator.wave_type = WAVE_SQUARE; break;
                     case SDLK_3: AppState.generator.wave_type = WAVE_SAWTOOTH; break;
                     case SDLK_4: AppState.generator.wave_type = WAVE_TRIANGLE; break;
+                    case SDLK_LEFTBRACKET: request_fft_size(SDL_AtomicGet(&AppState.settings.fft_size) / 2); break;
+                    case SDLK_RIGHTBRACKET: request_fft_size(SDL_AtomicGet(&AppState.settings.fft_size) * 2); break;
+                    case SDLK_o: cycle_overlap(); break;
+                    case SDLK_h: AppState.waterfall_on = !AppState.waterfall_on; break;
+                    case SDLK_n: AppState.pitch_on = !AppState.pitch_on; break;
+                    case SDLK_g: AppState.average_mode = (AppState.average_mode + 1) % AVERAGE_MODE_COUNT; break;
+                    case SDLK_i: AppState.perf_overlay_on = !AppState.perf_overlay_on; break;
+                    case SDLK_c: toggle_recording(); break;
+                    case SDLK_v: AppState.channel_layout = AppState.channel_layout == CHANNELS_OVERLAY ? CHANNELS_STACKED : CHANNELS_OVERLAY; break;
                 }
             }
             if (e.type == SDL_MOUSEBUTTONDOWN) {
                 if (e.button.x >= AppState.generator_button_rect.x && e.button.x <= AppState.generator_button_rect.x + AppState.generator_button_rect.w &&
                     e.button.y >= AppState.generator_button_rect.y && e.button.y <= AppState.generator_button_rect.y + AppState.generator_button_rect.h) {
                     AppState.generator.is_on = !AppState.generator.is_on;
+                    AppState.playback_last_us = 0;     // The callback is stopped while paused.
                     if (AppState.play_device > 0) SDL_PauseAudioDevice(AppState.play_device, !AppState.generator.is_on);
                 }
             }
         }
 
-        // --- Analysis (if not globally paused) ---
-        if (!AppState.is_paused) {
-            Complex fft_input[REC_BUFFER_SIZE];
-            double rms = 0.0;
-            SDL_LockAudioDevice(AppState.rec_device);
-            for(int i = 0; i < REC_BUFFER_SIZE; ++i) rms += (double)AppState.rec_buffer[i] * (double)AppState.rec_buffer[i];
-            rms = sqrt(rms / REC_BUFFER_SIZE);
-
-            if (rms > AppState.squelch_threshold) {
-                if (AppState.trigger_lock_on) {
-                    for (int i = 1; i < REC_BUFFER_SIZE - 1; ++i) {
-                        if (AppState.rec_buffer[i-1] < 0 && AppState.rec_buffer[i] >= 0) {
-                            trigger_offset = i; break;
-                        }
-                    }
-                } else { trigger_offset = 0; }
-
-                for(int i = 0; i < REC_BUFFER_SIZE; ++i) {
-                    double hann = 0.5 * (1 - cos(2 * M_PI * i / (REC_BUFFER_SIZE - 1)));
-                    fft_input[i].real = (double)AppState.rec_buffer[i] * hann;
-                    fft_input[i].imag = 0.0;
-                }
-                fft(fft_input, REC_BUFFER_SIZE);
-
-                double max_db = -1000.0; int peak_index = 0;
-                for(int i = 1; i < REC_BUFFER_SIZE / 2; ++i) {
-                    double mag = sqrt(fft_input[i].real*fft_input[i].real + fft_input[i].imag*fft_input[i].imag);
-                    double db = 20 * log10(mag + 1e-9);
-                    if (db > max_db) { max_db = db; peak_index = i; }
-                    if (db > AppState.peak_hold_magnitudes[i]) {
-                        AppState.peak_hold_magnitudes[i] = db;
-                    }
-                }
+        perf_mark(&AppState.perf[PERF_EVENTS], &mark);
+        publish_analysis_settings();
 
-                double max_freq = SAMPLE_RATE / 2.0;
-                double target_freq = (double)peak_index / (REC_BUFFER_SIZE / 2.0) * max_freq;
-                
-                if (AppState.auto_timebase_on) {
-                    int target_samples = (target_freq > 0) ? (4.0 * (SAMPLE_RATE / target_freq)) : 2048;
-                    if (target_samples < 100) target_samples = 100;
-                    if (target_samples > REC_BUFFER_SIZE) target_samples = REC_BUFFER_SIZE;
-                    AppState.scope_display_samples = (0.95 * AppState.scope_display_samples) + (0.05 * target_samples);
-                } else {
-                    AppState.scope_display_samples = 2048;
-                }
-
-                double min_log_freq = log10(20.0), max_log_freq = log10(max_freq);
-                double log_freq_range = max_log_freq - min_log_freq;
-                double log_peak_freq = log10(target_freq > 0 ? target_freq : 1.0);
-                double target_x = AppState.spectrum_panel_rect.x + (((log_peak_freq - min_log_freq) / log_freq_range) * AppState.spectrum_panel_rect.w);
-
-                AppState.peak_marker.x_pos = (0.7 * AppState.peak_marker.x_pos) + (0.3 * target_x);
-                AppState.peak_marker.db = (0.7 * AppState.peak_marker.db) + (0.3 * max_db);
-                AppState.peak_marker.frequency = target_freq;
-            } else {
-                AppState.peak_marker.db *= 0.99;
-                if (AppState.peak_marker.db < 20.0) { AppState.peak_marker.db = 20.0; AppState.peak_marker.frequency = 0.0; }
-            }
-            
-            for (int i = 0; i < REC_BUFFER_SIZE / 2; ++i) {
-                AppState.peak_hold_magnitudes[i] *= 0.9995;
-            }
-            SDL_UnlockAudioDevice(AppState.rec_device);
+        // Waterfall rows arrive once per hop, whether or not the frame they
+        // belong to is ever displayed, so they go to the texture on every
+        // wake-up, drawn or not. A filling ring wakes the loop for this.
+        for (const Uint8* row; (row = row_ring_peek(&AppState.waterfall_rows)) != NULL; row_ring_release(&AppState.waterfall_rows)) {
+            waterfall_push(&AppState.waterfall, row);
         }
+        if (!AppState.is_running || redraw_wait_ms() > 0) continue;
+        AppState.ui_dirty = 0;
+        AppState.last_redraw_ms = SDL_GetTicks();
+        SDL_AtomicSet(&AppState.frame_event_pending, 0);
+        const DisplayFrame* frame = latest_display_frame();
+        perf_mark(&AppState.perf[PERF_HANDOFF], &mark);
 
         // --- Drawing ---
-        SDL_SetRenderDrawColor(AppState.renderer, 20, 22, 25, 255);
-        SDL_RenderClear(AppState.renderer);
-
-        draw_panel("OSCILLOSCOPE", AppState.scope_panel_rect);
-        draw_panel("SPECTRUM ANALYZER", AppState.spectrum_panel_rect);
-        draw_scope_graticule();
-        draw_spectrum_graticule();
-        
-        SDL_SetRenderDrawBlendMode(AppState.renderer, SDL_BLENDMODE_ADD);
-        SDL_SetRenderDrawColor(AppState.renderer, 200, 200, 220, 150);
-        for (int i = 0; i < AppState.scope_display_samples - 1; ++i) {
-            int sample_idx1 = (trigger_offset + i) % REC_BUFFER_SIZE;
-            int sample_idx2 = (trigger_offset + i + 1) % REC_BUFFER_SIZE;
-            int x1 = AppState.scope_panel_rect.x + (float)i / AppState.scope_display_samples * AppState.scope_panel_rect.w;
-            int y1 = AppState.scope_panel_rect.y + AppState.scope_panel_rect.h/2 - AppState.rec_buffer[sample_idx1] * AppState.scope_panel_rect.h/2 / 32767.0 * AppState.scope_gain;
-            int x2 = AppState.scope_panel_rect.x + (float)(i + 1) / AppState.scope_display_samples * AppState.scope_panel_rect.w;
-            int y2 = AppState.scope_panel_rect.y + AppState.scope_panel_rect.h/2 - AppState.rec_buffer[sample_idx2] * AppState.scope_panel_rect.h/2 / 32767.0 * AppState.scope_gain;
-            SDL_RenderDrawLine(AppState.renderer, x1, y1, x2, y2);
+        char buffer[128];
+        update_background();
+        if (AppState.background) {
+            SDL_RenderCopy(AppState.renderer, AppState.background, NULL, NULL);
+        } else {
+            draw_background();
         }
-        SDL_SetRenderDrawBlendMode(AppState.renderer, SDL_BLENDMODE_NONE);
+        perf_mark(&AppState.perf[PERF_BACKGROUND], &mark);
 
-        double db_range = 110.0 - 20.0;
-        
-        SDL_SetRenderDrawColor(AppState.renderer, 255, 0, 80, 255);
-        double max_freq = SAMPLE_RATE / 2.0;
-        double min_log_freq = log10(20.0), max_log_freq = log10(max_freq);
-        double log_freq_range = max_log_freq - min_log_freq;
-        for (int i = 1; i < REC_BUFFER_SIZE / 2; ++i) {
-            double db = AppState.peak_hold_magnitudes[i];
-            if (db > 20.0) {
-                double freq = (double)i / (REC_BUFFER_SIZE / 2.0) * max_freq;
-                double log_f = log10(freq);
-                int x = AppState.spectrum_panel_rect.x + (((log_f - min_log_freq) / log_freq_range) * AppState.spectrum_panel_rect.w);
-                double mag_scaled = (db - 20.0) / db_range;
-                if (mag_scaled < 0.0) { mag_scaled = 0.0; }
-                if (mag_scaled > 1.0) { mag_scaled = 1.0; }
-                int bar_height = (int)(mag_scaled * AppState.spectrum_panel_rect.h * AppState.visual_gain);
-                SDL_RenderDrawLine(AppState.renderer, x, AppState.spectrum_panel_rect.y + AppState.spectrum_panel_rect.h - bar_height, x, AppState.spectrum_panel_rect.y + AppState.spectrum_panel_rect.h - bar_height + 1);
+        if (AppState.waterfall_on) {
+            waterfall_draw(&AppState.waterfall, AppState.renderer, waterfall_rect());
+        } else {
+            SDL_SetRenderDrawBlendMode(AppState.renderer, SDL_BLENDMODE_ADD);
+            for (int c = 0; c < frame->channels; ++c) {
+                SDL_Rect lane = channel_lane(AppState.scope_panel_rect, c, frame->channels);
+                SDL_Color color = channel_color(c, frame->channels, (SDL_Color){200, 200, 220, 150});
+                SDL_SetRenderDrawColor(AppState.renderer, color.r, color.g, color.b, 150);
+                SDL_RenderDrawLines(AppState.renderer, AppState.scope_points, build_scope_trace(frame, c, lane, AppState.scope_points));
+            }
+            SDL_SetRenderDrawBlendMode(AppState.renderer, SDL_BLENDMODE_NONE);
+            if (AppState.trigger_mode != TRIGGER_OFF) {
+                SDL_Rect lane = channel_lane(AppState.scope_panel_rect, 0, frame->channels);
+                int y = lane.y + lane.h / 2 - (int)(AppState.trigger_level * (lane.h / 2 / 32767.0) * AppState.scope_gain);
+                if (y > lane.y && y < lane.y + lane.h) {
+                    SDL_SetRenderDrawColor(AppState.renderer, 255, 200, 0, 255);
+                    SDL_RenderDrawLine(AppState.renderer, lane.x, y, lane.x + 10, y);
+                }
             }
         }
+        perf_mark(&AppState.perf[PERF_SCOPE], &mark);
+
+        double db_range = SPECTRUM_DB_TOP - SPECTRUM_DB_FLOOR;
 
-        if (AppState.peak_marker.db > 20.0) {
-            double mag_scaled = (AppState.peak_marker.db - 20.0) / db_range;
+        for (int c = 0; c < frame->channels; ++c) {
+            SDL_Rect lane = channel_lane(AppState.spectrum_panel_rect, c, frame->channels);
+            SDL_Color color = channel_color(c, frame->channels, (SDL_Color){255, 0, 80, 255});
+            SDL_SetRenderDrawColor(AppState.renderer, color.r, color.g, color.b, 255);
+            SDL_RenderFillRects(AppState.renderer, AppState.peak_hold_marks, build_peak_hold_marks(frame, c, lane, AppState.peak_hold_marks));
+        }
+        if (frame->average_on) draw_average(frame, channel_lane(AppState.spectrum_panel_rect, 0, frame->channels));
+        if (frame->peak_marker.db > SPECTRUM_DB_FLOOR) {
+            double mag_scaled = (frame->peak_marker.db - SPECTRUM_DB_FLOOR) / db_range;
             if (mag_scaled < 0.0) { mag_scaled = 0.0; }
             if (mag_scaled > 1.0) { mag_scaled = 1.0; }
-            int bar_height = (int)(mag_scaled * AppState.spectrum_panel_rect.h * AppState.visual_gain);
-            SDL_Rect peak_bar = {(int)AppState.peak_marker.x_pos, AppState.spectrum_panel_rect.y + AppState.spectrum_panel_rect.h - bar_height, 3, bar_height};
+            SDL_Rect marker_lane = channel_lane(AppState.spectrum_panel_rect, 0, frame->channels);
+            int bar_height = (int)(mag_scaled * marker_lane.h * AppState.visual_gain);
+            SDL_Rect peak_bar = {(int)frame->peak_marker.x_pos, marker_lane.y + marker_lane.h - bar_height, 3, bar_height};
             SDL_SetRenderDrawBlendMode(AppState.renderer, SDL_BLENDMODE_ADD);
             SDL_SetRenderDrawColor(AppState.renderer, 100, 100, 0, 255);
             SDL_Rect glow_bar = peak_bar; glow_bar.x -= 2; glow_bar.w += 4;
@@ -290,63 +721,104 @@ int main(int argc, char* argv[]) {
             SDL_RenderFillRect(AppState.renderer, &peak_bar);
             SDL_SetRenderDrawBlendMode(AppState.renderer, SDL_BLENDMODE_NONE);
         }
+        perf_mark(&AppState.perf[PERF_SPECTRUM], &mark);
 
-        SDL_SetRenderDrawColor(AppState.renderer, 255, 255, 255, 100);
-        SDL_RenderDrawLine(AppState.renderer, 0, 300, SCREEN_WIDTH, 300);
+        if (AppState.latency_samples > 0) {
+            snprintf(buffer, sizeof(buffer), "latency %.1f ms / period %d", AppState.latency_ms, AppState.capture_spec.samples);
+            SDL_Color latency_color = {150, 150, 150, 255};
+            draw_value(buffer, AppState.font_small, AppState.scope_panel_rect.x + AppState.scope_panel_rect.w - 5,
+                       AppState.scope_panel_rect.y + AppState.scope_panel_rect.h - 18, latency_color, TEXT_ALIGN_RIGHT);
+        }
+        if (recorder_is_active(&AppState.recorder)) {
+            int seconds = SDL_AtomicGet(&AppState.recorder.seconds);
+            int dropped = SDL_AtomicGet(&AppState.recorder.dropped_blocks);
+            if (dropped > 0) snprintf(buffer, sizeof(buffer), "REC %02d:%02d, %d BLOCKS DROPPED (C)", seconds / 60, seconds % 60, dropped);
+            else snprintf(buffer, sizeof(buffer), "REC %02d:%02d (C)", seconds / 60, seconds % 60);
+            SDL_Color rec_color = {255, 60, 60, 255};
+            draw_value(buffer, AppState.font_small, AppState.scope_panel_rect.x + 5,
+                       AppState.scope_panel_rect.y + AppState.scope_panel_rect.h - 18, rec_color, TEXT_ALIGN_LEFT);
+        }
+        if (AppState.waterfall_on) {
+            SDL_Color label_color = {150, 150, 150, 255};
+            draw_text("WATERFALL (H)", AppState.font_small, AppState.scope_panel_rect.x + 110, AppState.scope_panel_rect.y + 5, label_color, TEXT_ALIGN_LEFT);
+        }
+        if (frame->channels > 1) {
+            snprintf(buffer, sizeof(buffer), "%d CH %s (V)", frame->channels, AppState.channel_layout == CHANNELS_STACKED ? "STACKED" : "OVERLAY");
+            SDL_Color label_color = {150, 150, 150, 255};
+            draw_text(buffer, AppState.font_small, AppState.scope_panel_rect.x + AppState.scope_panel_rect.w - 5, AppState.scope_panel_rect.y + 5, label_color, TEXT_ALIGN_RIGHT);
+        }
 
-        char buffer[128];
         const char* wave_names[] = {"SINE", "SQUARE", "SAWTOOTH", "TRIANGLE"};
         SDL_Color text_color = {200, 200, 200, 255};
         SDL_Color value_color = {0, 255, 200, 255};
         SDL_Color peak_color = {255, 255, 0, 255};
         
         int y_pos = AppState.controls_panel_rect.y + 30;
-        draw_text("Squelch:", AppState.font_medium, 30, y_pos, text_color, 0);
+        draw_text("Squelch:", AppState.font_medium, 30, y_pos, text_color, TEXT_ALIGN_LEFT);
         snprintf(buffer, sizeof(buffer), "%.0f", AppState.squelch_threshold);
-        draw_text(buffer, AppState.font_medium, 280, y_pos, value_color, 1);
+        draw_value(buffer, AppState.font_medium, 280, y_pos, value_color, TEXT_ALIGN_RIGHT);
 
         y_pos += 25;
-        draw_text("Spec. Gain:", AppState.font_medium, 30, y_pos, text_color, 0);
+        draw_text("Spec. Gain:", AppState.font_medium, 30, y_pos, text_color, TEXT_ALIGN_LEFT);
         snprintf(buffer, sizeof(buffer), "%.2fx", AppState.visual_gain);
-        draw_text(buffer, AppState.font_medium, 280, y_pos, value_color, 1);
+        draw_value(buffer, AppState.font_medium, 280, y_pos, value_color, TEXT_ALIGN_RIGHT);
 
         y_pos += 25;
-        draw_text("Scope Gain (W/S):", AppState.font_medium, 30, y_pos, text_color, 0);
+        draw_text("Scope Gain (W/S):", AppState.font_medium, 30, y_pos, text_color, TEXT_ALIGN_LEFT);
         snprintf(buffer, sizeof(buffer), "%.2fx", AppState.scope_gain);
-        draw_text(buffer, AppState.font_medium, 280, y_pos, value_color, 1);
+        draw_value(buffer, AppState.font_medium, 280, y_pos, value_color, TEXT_ALIGN_RIGHT);
 
         y_pos += 25;
-        draw_text("Trigger Lock (T):", AppState.font_medium, 30, y_pos, text_color, 0);
-        SDL_Color trigger_color = AppState.trigger_lock_on ? value_color : (SDL_Color){255,100,100,255};
-        draw_text(AppState.trigger_lock_on ? "ON" : "OFF", AppState.font_medium, 280, y_pos, trigger_color, 1);
+        const char* trigger_modes[TRIGGER_MODE_COUNT] = {"OFF", "AUTO", "NORM"};
+        draw_text("Trigger (T,E):", AppState.font_medium, 30, y_pos, text_color, TEXT_ALIGN_LEFT);
+        SDL_Color trigger_color = AppState.trigger_mode != TRIGGER_OFF ? value_color : (SDL_Color){255,100,100,255};
+        if (AppState.trigger_mode == TRIGGER_OFF) snprintf(buffer, sizeof(buffer), "OFF");
+        else snprintf(buffer, sizeof(buffer), "%s %c%d", trigger_modes[AppState.trigger_mode], AppState.trigger_slope == TRIGGER_RISING ? '/' : '\\', AppState.trigger_level);
+        draw_value(buffer, AppState.font_medium, 280, y_pos, trigger_color, TEXT_ALIGN_RIGHT);
 
         y_pos += 25;
-        draw_text("Auto-Timebase (A):", AppState.font_medium, 30, y_pos, text_color, 0);
+        draw_text("Auto-Timebase (A):", AppState.font_medium, 30, y_pos, text_color, TEXT_ALIGN_LEFT);
         SDL_Color timebase_color = AppState.auto_timebase_on ? value_color : (SDL_Color){255,100,100,255};
-        draw_text(AppState.auto_timebase_on ? "ON" : "OFF", AppState.font_medium, 280, y_pos, timebase_color, 1);
+        draw_text(AppState.auto_timebase_on ? "ON" : "OFF", AppState.font_medium, 280, y_pos, timebase_color, TEXT_ALIGN_RIGHT);
+
+        y_pos += 25;
+        draw_text("FFT Size ([/]):", AppState.font_medium, 30, y_pos, text_color, TEXT_ALIGN_LEFT);
+        snprintf(buffer, sizeof(buffer), "%d", frame->fft_size);
+        draw_value(buffer, AppState.font_medium, 280, y_pos, value_color, TEXT_ALIGN_RIGHT);
+
+        y_pos += 25;
+        draw_text("Overlap (O):", AppState.font_medium, 30, y_pos, text_color, TEXT_ALIGN_LEFT);
+        snprintf(buffer, sizeof(buffer), "%.1f%%", 100.0 * (1.0 - (double)frame->hop_size / frame->fft_size));
+        draw_value(buffer, AppState.font_medium, 280, y_pos, value_color, TEXT_ALIGN_RIGHT);
 
         y_pos += 25;
-        draw_text("Waveform (1-4):", AppState.font_medium, 30, y_pos, text_color, 0);
-        draw_text(wave_names[AppState.generator.wave_type], AppState.font_medium, 280, y_pos, value_color, 1);
+        draw_text("Waveform (1-4):", AppState.font_medium, 30, y_pos, text_color, TEXT_ALIGN_LEFT);
+        draw_text(wave_names[AppState.generator.wave_type], AppState.font_medium, 280, y_pos, value_color, TEXT_ALIGN_RIGHT);
 
         if (AppState.generator.is_on) {
             y_pos += 25;
             const char* sweep_status = AppState.generator.is_paused ? "Paused (Space)" : "Sweeping";
             SDL_Color sweep_color = AppState.generator.is_paused ? peak_color : value_color;
-            draw_text("Gen Status:", AppState.font_medium, 30, y_pos, text_color, 0);
-            draw_text(sweep_status, AppState.font_medium, 280, y_pos, sweep_color, 1);
+            draw_text("Gen Status:", AppState.font_medium, 30, y_pos, text_color, TEXT_ALIGN_LEFT);
+            draw_text(sweep_status, AppState.font_medium, 280, y_pos, sweep_color, TEXT_ALIGN_RIGHT);
         }
         
         y_pos += 25;
-        draw_text("Reset Peaks (R)", AppState.font_medium, 30, y_pos, text_color, 0);
+        draw_text("Reset Peaks (R)", AppState.font_medium, 30, y_pos, text_color, TEXT_ALIGN_LEFT);
 
-        if (AppState.peak_marker.frequency > 0.0) {
+        if (frame->peak_marker.frequency > 0.0) {
             char note_buf[16];
-            freq_to_note(AppState.peak_marker.frequency, note_buf, sizeof(note_buf));
-            snprintf(buffer, sizeof(buffer), "%.1f Hz", AppState.peak_marker.frequency);
-            draw_text(buffer, AppState.font_large, SCREEN_WIDTH - 20, AppState.controls_panel_rect.y + 40, peak_color, 1);
-            draw_text(note_buf, AppState.font_large, SCREEN_WIDTH - 20, AppState.controls_panel_rect.y + 70, peak_color, 1);
+            freq_to_note(frame->peak_marker.frequency, note_buf, sizeof(note_buf));
+            snprintf(buffer, sizeof(buffer), "%.1f Hz", frame->peak_marker.frequency);
+            draw_value(buffer, AppState.font_large, SCREEN_WIDTH - 20, AppState.controls_panel_rect.y + 40, peak_color, TEXT_ALIGN_RIGHT);
+            draw_value(note_buf, AppState.font_large, SCREEN_WIDTH - 20, AppState.controls_panel_rect.y + 70, peak_color, TEXT_ALIGN_RIGHT);
         }
+        draw_text(AppState.pitch_on ? "PITCH (N)" : "PEAK (N)", AppState.font_small, SCREEN_WIDTH - 20, AppState.controls_panel_rect.y + 100, text_color, TEXT_ALIGN_RIGHT);
+        const char* average_modes[AVERAGE_MODE_COUNT] = {"OFF", "EXP", "LINEAR", "RMS"};
+        if (AppState.average_mode == AVERAGE_OFF) snprintf(buffer, sizeof(buffer), "AVG OFF (G)");
+        else if (AppState.average_mode == AVERAGE_EXPONENTIAL) snprintf(buffer, sizeof(buffer), "AVG EXP %.1f s (G)", AppState.average_time);
+        else snprintf(buffer, sizeof(buffer), "AVG %s x%d (G)", average_modes[AppState.average_mode], AppState.average_frames);
+        draw_text(buffer, AppState.font_small, SCREEN_WIDTH - 20, AppState.controls_panel_rect.y + 115, text_color, TEXT_ALIGN_RIGHT);
 
         SDL_Color btn_color = AppState.generator.is_on ? (SDL_Color){0, 180, 50, 255} : (SDL_Color){150, 0, 30, 255};
         SDL_Color btn_border_color = AppState.generator.is_on ? (SDL_Color){150, 255, 180, 255} : (SDL_Color){80, 80, 80, 255};
@@ -355,20 +827,58 @@ int main(int argc, char* argv[]) {
         SDL_SetRenderDrawColor(AppState.renderer, btn_border_color.r, btn_border_color.g, btn_border_color.b, 255);
         SDL_RenderDrawRect(AppState.renderer, &AppState.generator_button_rect);
         SDL_Color btn_text_color = {255,255,255,255};
-        draw_text(AppState.generator.is_on ? "GENERATOR ON" : "GENERATOR OFF", AppState.font_medium, AppState.generator_button_rect.x + 75, AppState.generator_button_rect.y + 17, btn_text_color, 0);
+        draw_text(AppState.generator.is_on ? "GENERATOR ON" : "GENERATOR OFF", AppState.font_medium, AppState.generator_button_rect.x + AppState.generator_button_rect.w / 2, AppState.generator_button_rect.y + 17, btn_text_color, TEXT_ALIGN_CENTER);
 
         if (AppState.is_paused) {
             SDL_Color paused_color = {255,0,0,255};
-            draw_text("ANALYZER PAUSED (P)", AppState.font_large, SCREEN_WIDTH / 2, 15, paused_color, 0);
+            draw_text("ANALYZER PAUSED (P)", AppState.font_large, SCREEN_WIDTH / 2, 15, paused_color, TEXT_ALIGN_CENTER);
         }
+        if (AppState.perf_overlay_on) draw_perf_overlay();
+        perf_mark(&AppState.perf[PERF_TEXT], &mark);
 
         SDL_RenderPresent(AppState.renderer);
+        perf_mark(&AppState.perf[PERF_PRESENT], &mark);
+        record_latency(frame);
+        perf_mark(&AppState.perf[PERF_FRAME], &frame_start);
+        perf_end_frame(frame);
     }
 
     // --- Cleanup ---
+    if (AppState.latency_samples > 0) {
+        fprintf(report_stream(), "Input-to-present latency: mean %.1f ms, max %.1f ms over %llu frames (capture period %d frames at %.0f Hz)\n",
+               AppState.latency_sum_ms / AppState.latency_samples, AppState.latency_max_ms,
+               (unsigned long long)AppState.latency_samples, AppState.capture_spec.samples, AppState.sample_rate);
+    }
+    fprintf(report_stream(), "Callbacks: capture dropped %d samples and ran late %d times, playback ran late %d times\n",
+           capture_dropped(), SDL_AtomicGet(&AppState.capture_late), SDL_AtomicGet(&AppState.playback_late));
+    if (AppState.stats_file && AppState.stats_file != stdout) fclose(AppState.stats_file);
+    if (recorder_is_active(&AppState.recorder)) toggle_recording();
+    SDL_AtomicSet(&AppState.analysis_running, 0);
+    SDL_SemPost(AppState.capture_ready);
+    SDL_WaitThread(AppState.analysis_thread, NULL);
+    if (AppState.stream_target_count > 0) {
+        fprintf(report_stream(), "Streamed %llu frames as %llu datagrams (%llu dropped) to %d targets\n",
+               (unsigned long long)AppState.stream.frames, (unsigned long long)AppState.stream.packets_sent,
+               (unsigned long long)AppState.stream.packets_dropped, AppState.stream.target_count);
+        netstream_close(&AppState.stream);
+    }
+    if (AppState.background) SDL_DestroyTexture(AppState.background);
+    waterfall_free(&AppState.waterfall);
+    row_ring_free(&AppState.waterfall_rows);
+    text_cache_free(&AppState.text_cache);
     TTF_CloseFont(AppState.font_large); TTF_CloseFont(AppState.font_medium); TTF_CloseFont(AppState.font_small);
+    for (int c = 0; c < AppState.channels; ++c) {
+        analyzer_free(&AppState.analyzers[c]);
+        multirate_free(&AppState.multirate[c]);
+    }
+    freq_axis_free(&AppState.marker_axis);
+    wavetables_free(&AppState.wavetables);
+    freq_axis_free(&AppState.spectrum_axis);
     if(AppState.rec_device > 0) SDL_CloseAudioDevice(AppState.rec_device);
     if(AppState.play_device > 0) SDL_CloseAudioDevice(AppState.play_device);
+    for (int c = 0; c < AppState.channels; ++c) sample_ring_free(&AppState.capture_rings[c]);
+    SDL_DestroySemaphore(AppState.capture_ready);
+    free(AppState.display_frames);
     SDL_DestroyRenderer(AppState.renderer);
     SDL_DestroyWindow(AppState.window);
     TTF_Quit();
@@ -379,85 +889,242 @@ int main(int argc, char* argv[]) {
 
 // --- Function Implementations ---
 
-void fft(Complex* x, int n) {
-    if (n <= 1) return;
-    Complex even[n / 2], odd[n / 2];
-    for (int i = 0; i < n / 2; i++) { even[i] = x[2*i]; odd[i] = x[2*i+1]; }
-    fft(even, n / 2); fft(odd, n / 2);
-    for (int k = 0; k < n / 2; k++) {
-        double angle = -2 * M_PI * k / n;
-        Complex t = {cos(angle)*odd[k].real - sin(angle)*odd[k].imag, cos(angle)*odd[k].imag + sin(angle)*odd[k].real};
-        x[k].real = even[k].real + t.real; x[k].imag = even[k].imag + t.imag;
-        x[k + n/2].real = even[k].real - t.real; x[k + n/2].imag = even[k].imag - t.imag;
+// Opens the default capture device, letting it keep its own rate and sample
+// format so SDL does not resample or convert. A mono request also accepts
+// the device's channel count and downmixes it in the callback; a
+// multi-channel request gets exactly that many channels. Falls back to
+// SDL's conversion if the device picks a format the callback cannot read.
+SDL_AudioDeviceID open_capture_device(int rate, int channels, int period) {
+    int channel_change = channels == 1 ? SDL_AUDIO_ALLOW_CHANNELS_CHANGE : 0;
+    SDL_AudioSpec want;
+    SDL_zero(want);
+    want.freq = rate; want.format = AUDIO_F32SYS; want.channels = channels;
+    want.samples = period; want.callback = recording_callback;
+    SDL_AudioDeviceID device = SDL_OpenAudioDevice(NULL, 1, &want, &AppState.capture_spec,
+        SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_FORMAT_CHANGE | channel_change);
+    SDL_AudioFormat format = AppState.capture_spec.format;
+    if (device > 0 && format != AUDIO_S16SYS && format != AUDIO_S32SYS && format != AUDIO_F32SYS) {
+        SDL_CloseAudioDevice(device);
+        device = 0;
     }
+    if (device == 0) {
+        want.format = AUDIO_S16SYS;
+        device = SDL_OpenAudioDevice(NULL, 1, &want, &AppState.capture_spec,
+            SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | channel_change);
+    }
+    if (device == 0) fprintf(stderr, "Could not open a capture device: %s\n", SDL_GetError());
+    return device;
 }
 
-void recording_callback(void* userdata, Uint8* stream, int len) {
-    if (!AppState.is_paused) {
-        SDL_memcpy(AppState.rec_buffer, stream, len > sizeof(AppState.rec_buffer) ? sizeof(AppState.rec_buffer) : len);
-    }
+static inline double capture_sample(const Uint8* stream, SDL_AudioFormat format, int k) {
+    if (format == AUDIO_F32SYS) return ((const float*)stream)[k] * 32767.0;
+    if (format == AUDIO_S32SYS) return ((const Sint32*)stream)[k] / 65536.0;
+    return ((const Sint16*)stream)[k];
 }
 
-void playback_callback(void* userdata, Uint8* stream, int len) {
-    Sint16* buffer = (Sint16*)stream;
-    int num_samples = len / sizeof(Sint16);
-    double sweep_duration_s = 20.0, start_freq = 20.0, end_freq = 5000.0;
-
-    for (int i = 0; i < num_samples; ++i) {
-        if (!AppState.generator.is_paused) {
-            double sweep_progress = AppState.generator.sweep_time / sweep_duration_s;
-            AppState.generator.current_freq = AppState.generator.sweep_up ?
-                start_freq + (end_freq - start_freq) * sweep_progress :
-                end_freq - (end_freq - start_freq) * sweep_progress;
-
-            AppState.generator.sweep_time += 1.0 / SAMPLE_RATE;
-            if (AppState.generator.sweep_time >= sweep_duration_s) {
-                AppState.generator.sweep_time = 0.0;
-                AppState.generator.sweep_up = !AppState.generator.sweep_up;
+static inline Sint16 clamp_sample(double v) {
+    return v >= 32767.0 ? 32767 : v <= -32768.0 ? -32768 : (Sint16)v;
+}
+
+// Converts the device's native frames to Sint16 and deinterleaves them into
+// one ring per channel, all in one pass. A mono analysis averages whatever
+// channels the device delivers.
+void recording_callback(void* userdata, Uint8* stream, int len) {
+    count_late_callback(&AppState.capture_last_us, AppState.capture_spec.samples, AppState.capture_spec.freq, &AppState.capture_late);
+    // Pausing freezes the analysis, not a recording in progress.
+    const int paused = AppState.is_paused;
+    Recorder* rec = &AppState.recorder;
+    if (paused && !SDL_AtomicGet(&rec->active)) return;
+    const SDL_AudioSpec* spec = &AppState.capture_spec;
+    const SDL_AudioFormat format = spec->format;
+    const int in_channels = spec->channels > 0 ? spec->channels : 1;
+    const int channels = AppState.channels;
+    const int sample_bytes = SDL_AUDIO_BITSIZE(format) / 8;
+    int frames = len / (sample_bytes * in_channels);
+
+    if (format == AUDIO_S16SYS && in_channels == 1) {
+        if (!paused) sample_ring_write(&AppState.capture_rings[0], (const Sint16*)stream, frames);
+        if (recorder_accept(rec, frames)) recorder_write(rec, 0, (const Sint16*)stream, frames);
+    } else {
+        Sint16 block[1024];
+        for (int done = 0; done < frames; ) {
+            int n = frames - done < 1024 ? frames - done : 1024;
+            const int record = recorder_accept(rec, n);
+            if (channels == 1) {
+                for (int i = 0; i < n; ++i) {
+                    double sum = 0.0;
+                    for (int c = 0; c < in_channels; ++c) sum += capture_sample(stream, format, (done + i) * in_channels + c);
+                    block[i] = clamp_sample(sum / in_channels);
+                }
+                if (!paused) sample_ring_write(&AppState.capture_rings[0], block, n);
+                if (record) recorder_write(rec, 0, block, n);
+            } else {
+                for (int c = 0; c < channels; ++c) {
+                    for (int i = 0; i < n; ++i) block[i] = clamp_sample(capture_sample(stream, format, (done + i) * in_channels + c));
+                    if (!paused) sample_ring_write(&AppState.capture_rings[c], block, n);
+                    if (record) recorder_write(rec, c, block, n);
+                }
             }
+            done += n;
         }
+    }
+    if (paused) return;
+    SDL_AtomicSet(&AppState.capture_stamp_us, (int)clock_us());
+    SDL_SemPost(AppState.capture_ready);
+}
 
-        double sample = 0.0;
-        switch (AppState.generator.wave_type) {
-            case WAVE_SINE: sample = sin(AppState.generator.phase); break;
-            case WAVE_SQUARE: sample = sin(AppState.generator.phase) >= 0 ? 1.0 : -1.0; break;
-            case WAVE_SAWTOOTH: sample = (fmod(AppState.generator.phase, 2.0 * M_PI) / M_PI) - 1.0; break;
-            case WAVE_TRIANGLE: sample = 2.0 * fabs(fmod(AppState.generator.phase / (2.0 * M_PI), 1.0) * 2.0 - 1.0) - 1.0; break;
-        }
-        buffer[i] = (Sint16)(12000 * sample);
+// Where run summaries go: stdout, unless `--stats -` streams CSV there.
+FILE* report_stream() {
+    return AppState.stats_file == stdout ? stderr : stdout;
+}
+
+// Microseconds on the performance counter, wrapping every ~71 minutes.
+// Only differences are used, so the wrap is harmless.
+Uint32 clock_us() {
+    return (Uint32)(Uint64)(SDL_GetPerformanceCounter() / AppState.ticks_per_us);
+}
 
-        AppState.generator.phase += 2.0 * M_PI * AppState.generator.current_freq / SAMPLE_RATE;
+// Measures how long after its newest block arrived a frame reached the
+// screen, once per newly presented frame. With vsync on, SDL_RenderPresent
+// returns at the swap, so this covers the callback, analysis, hand-off and
+// render stages; add the device's own buffering for true input-to-photon.
+void record_latency(const DisplayFrame* frame) {
+    if (frame->frame_count == AppState.last_presented_frame || frame->capture_stamp_us == 0) return;
+    AppState.last_presented_frame = frame->frame_count;
+    double ms = (Uint32)(clock_us() - frame->capture_stamp_us) / 1000.0;
+    AppState.latency_ms = AppState.latency_samples == 0 ? ms : 0.9 * AppState.latency_ms + 0.1 * ms;
+    if (ms > AppState.latency_max_ms) AppState.latency_max_ms = ms;
+    AppState.latency_sum_ms += ms;
+    AppState.latency_samples++;
+}
+
+// Adds the time since *mark to `hist` and moves the mark to now.
+void perf_mark(PerfHistogram* hist, Uint64* mark) {
+    Uint64 now = SDL_GetPerformanceCounter();
+    perf_hist_add(hist, (now - *mark) / AppState.ticks_per_us);
+    *mark = now;
+}
+
+// Samples the capture rings had to discard because analysis fell behind.
+int capture_dropped() {
+    int dropped = 0;
+    for (int c = 0; c < AppState.channels; ++c) dropped += SDL_AtomicGet(&AppState.capture_rings[c].dropped);
+    return dropped;
+}
+
+// A callback arriving more than one and a half periods after the previous
+// one means the device buffer ran dry (playback) or overflowed (capture)
+// in between. SDL does not report either, so this is the closest signal.
+void count_late_callback(Uint32* last_us, int period, int rate, SDL_atomic_t* late) {
+    Uint32 now = clock_us();
+    if (*last_us != 0 && rate > 0 && (Uint32)(now - *last_us) > 1.5e6 * period / rate) SDL_AtomicIncRef(late);
+    *last_us = now;
+}
+
+void write_stats_header() {
+    fprintf(AppState.stats_file, "time_s");
+    for (int s = 0; s < PERF_SECTION_COUNT; ++s) {
+        const char* name = perf_section_names[s];
+        fprintf(AppState.stats_file, ",%s_n,%s_mean_us,%s_p50_us,%s_p99_us,%s_max_us", name, name, name, name, name);
     }
-    if (AppState.generator.phase > 2.0 * M_PI) AppState.generator.phase -= 2.0 * M_PI;
+    fprintf(AppState.stats_file, ",capture_dropped,capture_late,playback_late\n");
 }
 
-void draw_text(const char* text, TTF_Font* font, int x, int y, SDL_Color color, int align_right) {
-    SDL_Surface* surface = TTF_RenderText_Blended(font, text, color);
-    if (!surface) return;
-    SDL_Texture* texture = SDL_CreateTextureFromSurface(AppState.renderer, surface);
-    SDL_Rect rect = { x, y, surface->w, surface->h };
-    if (align_right) rect.x -= surface->w;
-    if (y == AppState.generator_button_rect.y + 17) {
-        rect.x = AppState.generator_button_rect.x + (AppState.generator_button_rect.w - surface->w) / 2;
+// Closes the reporting window once it has run PERF_WINDOW_US. The overlay
+// and the stats file then show the window just finished, alongside the
+// analysis thread's most recent one from the frame.
+void perf_end_frame(const DisplayFrame* frame) {
+    Uint32 now = clock_us();
+    if ((Uint32)(now - AppState.perf_window_start_us) < PERF_WINDOW_US) return;
+    AppState.perf_window_start_us = now;
+    memcpy(AppState.perf_shown, AppState.perf, sizeof(AppState.perf));
+    memcpy(&AppState.perf_shown[PERF_DSP_FIRST], frame->dsp_perf, sizeof(frame->dsp_perf));
+    for (int s = 0; s < PERF_DSP_FIRST; ++s) perf_hist_reset(&AppState.perf[s]);
+
+    if (!AppState.stats_file) return;
+    fprintf(AppState.stats_file, "%.3f", (double)(SDL_GetPerformanceCounter() - AppState.perf_start_ticks) / SDL_GetPerformanceFrequency());
+    for (int s = 0; s < PERF_SECTION_COUNT; ++s) {
+        const PerfHistogram* h = &AppState.perf_shown[s];
+        fprintf(AppState.stats_file, ",%u,%.1f,%.1f,%.1f,%.1f", h->count, perf_hist_mean(h),
+                perf_hist_percentile(h, 0.5), perf_hist_percentile(h, 0.99), h->max_us);
+    }
+    fprintf(AppState.stats_file, ",%d,%d,%d\n", capture_dropped(),
+            SDL_AtomicGet(&AppState.capture_late), SDL_AtomicGet(&AppState.playback_late));
+    fflush(AppState.stats_file);
+}
+
+// Per-section timings over the last window and a histogram of frame times,
+// drawn over the scope panel.
+void draw_perf_overlay() {
+    SDL_Rect box = {AppState.scope_panel_rect.x + 10, AppState.scope_panel_rect.y + 10, 440, 262};
+    SDL_Color label_color = {200, 200, 200, 255};
+    SDL_Color value_color = {0, 255, 200, 255};
+    char buffer[96];
+    SDL_SetRenderDrawBlendMode(AppState.renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(AppState.renderer, 0, 0, 0, 210);
+    SDL_RenderFillRect(AppState.renderer, &box);
+    SDL_SetRenderDrawBlendMode(AppState.renderer, SDL_BLENDMODE_NONE);
+    SDL_SetRenderDrawColor(AppState.renderer, 80, 80, 80, 255);
+    SDL_RenderDrawRect(AppState.renderer, &box);
+
+    int left = box.x + 8, right = box.x + box.w - 8, y = box.y + 6;
+    draw_text("us, last 1 s (I)", AppState.font_small, left, y, label_color, TEXT_ALIGN_LEFT);
+    draw_text("    n     mean      p50      p99      max", AppState.font_small, right, y, label_color, TEXT_ALIGN_RIGHT);
+    for (int s = 0; s < PERF_SECTION_COUNT; ++s) {
+        const PerfHistogram* h = &AppState.perf_shown[s];
+        y += 14;
+        draw_text(perf_section_names[s], AppState.font_small, left, y, label_color, TEXT_ALIGN_LEFT);
+        snprintf(buffer, sizeof(buffer), "%5u %8.0f %8.0f %8.0f %8.0f", h->count, perf_hist_mean(h),
+                 perf_hist_percentile(h, 0.5), perf_hist_percentile(h, 0.99), h->max_us);
+        draw_value(buffer, AppState.font_small, right, y, value_color, TEXT_ALIGN_RIGHT);
+    }
+    y += 18;
+    snprintf(buffer, sizeof(buffer), "capture dropped %d late %d / playback late %d", capture_dropped(),
+             SDL_AtomicGet(&AppState.capture_late), SDL_AtomicGet(&AppState.playback_late));
+    draw_value(buffer, AppState.font_small, left, y, value_color, TEXT_ALIGN_LEFT);
+
+    // Frame time histogram from 1 ms to about 130 ms, one bar per bin.
+    const int first_bin = 10 * PERF_BINS_PER_OCTAVE, bars = 7 * PERF_BINS_PER_OCTAVE;
+    const PerfHistogram* frames = &AppState.perf_shown[PERF_FRAME];
+    Uint32 tallest = 1;
+    for (int b = 0; b < bars; ++b) {
+        if (frames->bins[first_bin + b] > tallest) tallest = frames->bins[first_bin + b];
     }
-    if (x == SCREEN_WIDTH / 2) {
-        rect.x -= surface->w / 2;
+    int bar_w = (box.w - 16) / bars, base = box.y + box.h - 20, height = 48;
+    SDL_Rect bar_rects[7 * PERF_BINS_PER_OCTAVE];
+    for (int b = 0; b < bars; ++b) {
+        int h = (int)((double)frames->bins[first_bin + b] / tallest * height);
+        bar_rects[b] = (SDL_Rect){left + b * bar_w, base - h, bar_w - 1, h};
     }
-    SDL_RenderCopy(AppState.renderer, texture, NULL, &rect);
-    SDL_DestroyTexture(texture);
-    SDL_FreeSurface(surface);
+    SDL_SetRenderDrawColor(AppState.renderer, 0, 200, 160, 255);
+    SDL_RenderFillRects(AppState.renderer, bar_rects, bars);
+    snprintf(buffer, sizeof(buffer), "frame %.0f ms", perf_bin_upper_us(first_bin - 1) / 1000.0);
+    draw_value(buffer, AppState.font_small, left, base + 3, label_color, TEXT_ALIGN_LEFT);
+    snprintf(buffer, sizeof(buffer), "%.0f ms", perf_bin_upper_us(first_bin + bars - 1) / 1000.0);
+    draw_value(buffer, AppState.font_small, right, base + 3, label_color, TEXT_ALIGN_RIGHT);
 }
 
-void freq_to_note(double frequency, char* note_buffer, size_t buffer_size) {
-    if (frequency <= 0) {
-        snprintf(note_buffer, buffer_size, "---");
-        return;
+// The UI only flips the pause flag and the waveform; everything else about
+// the signal belongs to this callback.
+void playback_callback(void* userdata, Uint8* stream, int len) {
+    SignalGenerator* signal = &AppState.signal;
+    count_late_callback(&AppState.playback_last_us, AppState.play_period, (int)AppState.play_rate, &AppState.playback_late);
+    signal->paused = AppState.generator.is_paused;
+    if (AppState.generator.wave_type != AppState.signal_wave) {
+        AppState.signal_wave = AppState.generator.wave_type;
+        siggen_set_wave(signal, AppState.signal_wave);
     }
-    const char* note_names[] = {"C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"};
-    int note_num = (int)round(12 * log2(frequency / 440.0) + 69);
-    int octave = (note_num / 12) - 1;
-    int note_index = note_num % 12;
-    snprintf(note_buffer, buffer_size, "%s%d", note_names[note_index], octave);
+    siggen_render(signal, (Sint16*)stream, len / (int)(sizeof(Sint16) * signal->channels));
+}
+
+// Labels and other strings that rarely change come from the string cache.
+void draw_text(const char* text, TTF_Font* font, int x, int y, SDL_Color color, TextAlign align) {
+    text_cache_draw(&AppState.text_cache, font, text, x, y, color, align);
+}
+
+// Readouts that change every frame are assembled from the glyph atlas.
+void draw_value(const char* text, TTF_Font* font, int x, int y, SDL_Color color, TextAlign align) {
+    text_cache_draw_glyphs(&AppState.text_cache, font, text, x, y, color, align);
 }
 
 void draw_panel(const char* title, SDL_Rect rect) {
@@ -466,7 +1133,7 @@ void draw_panel(const char* title, SDL_Rect rect) {
     SDL_SetRenderDrawColor(AppState.renderer, 60, 62, 65, 255);
     SDL_RenderDrawRect(AppState.renderer, &rect);
     SDL_Color title_color = {150, 150, 150, 255};
-    draw_text(title, AppState.font_small, rect.x + 5, rect.y + 5, title_color, 0);
+    draw_text(title, AppState.font_small, rect.x + 5, rect.y + 5, title_color, TEXT_ALIGN_LEFT);
 }
 
 void draw_scope_graticule() {
@@ -489,21 +1156,485 @@ void draw_spectrum_graticule() {
         int y = rect.y + i * rect.h / 6;
         SDL_RenderDrawLine(AppState.renderer, rect.x, y, rect.x + rect.w, y);
     }
-    double freqs[] = {100, 200, 500, 1000, 2000, 5000, 10000};
-    double max_freq = SAMPLE_RATE / 2.0;
-    double min_log_freq = log10(20.0), max_log_freq = log10(max_freq);
-    double log_freq_range = max_log_freq - min_log_freq;
-    for (int i = 0; i < 7; i++) {
-        double log_f = log10(freqs[i]);
-        int x = rect.x + (((log_f - min_log_freq) / log_freq_range) * rect.w);
+    double freqs[] = {100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000};
+    for (int i = 0; i < 9; i++) {
+        int x = rect.x + freq_axis_position(freqs[i], AppState.sample_rate / 2.0, rect.w);
         if (x > rect.x && x < rect.x + rect.w) {
             SDL_RenderDrawLine(AppState.renderer, x, rect.y, x, rect.y + rect.h);
         }
     }
 }
 
-void reset_peak_hold() {
-    for (int i = 0; i < REC_BUFFER_SIZE / 2; ++i) {
-        AppState.peak_hold_magnitudes[i] = -1000.0;
+// Lays the scope window out as one polyline, starting at the trigger point
+// and wrapping around the capture buffer. Returns the point count.
+//
+// When there are more samples than pixel columns, each column is reduced to
+// its minimum and maximum, emitted in the order they occurred, so the trace
+// never exceeds two vertices per column and no peak is dropped.
+int build_scope_trace(const DisplayFrame* frame, int channel, SDL_Rect rect, SDL_Point* points) {
+    const Sint16* scope = frame->scope[channel];
+    int count = frame->scope_display_samples;
+    if (count > REC_BUFFER_SIZE) count = REC_BUFFER_SIZE;
+    float x_scale = (float)rect.w / frame->scope_display_samples;
+    double y_scale = rect.h / 2 / 32767.0 * AppState.scope_gain;
+    int y_mid = rect.y + rect.h / 2;
+    int index = frame->trigger_offset;
+
+    if (count <= rect.w) {
+        for (int i = 0; i < count; ++i) {
+            points[i].x = rect.x + (int)(i * x_scale);
+            points[i].y = y_mid - (int)(scope[index] * y_scale);
+            if (++index == REC_BUFFER_SIZE) index = 0;
+        }
+        return count;
+    }
+
+    int emitted = 0;
+    int column = 0;
+    Sint16 lo = scope[index], hi = lo;
+    int lo_at = 0, hi_at = 0;
+    for (int i = 0; i <= count; ++i) {
+        int x = i < count ? (int)(i * x_scale) : -1;
+        if (x != column) {
+            Sint16 first = lo_at <= hi_at ? lo : hi;
+            Sint16 second = lo_at <= hi_at ? hi : lo;
+            points[emitted].x = rect.x + column;
+            points[emitted++].y = y_mid - (int)(first * y_scale);
+            if (lo != hi) {
+                points[emitted].x = rect.x + column;
+                points[emitted++].y = y_mid - (int)(second * y_scale);
+            }
+            if (i == count) break;
+            column = x;
+            lo = hi = scope[index];
+            lo_at = hi_at = i;
+        } else {
+            Sint16 v = scope[index];
+            if (v < lo) { lo = v; lo_at = i; }
+            if (v > hi) { hi = v; hi_at = i; }
+        }
+        if (++index == REC_BUFFER_SIZE) index = 0;
+    }
+    return emitted;
+}
+
+// One 1x2 mark per pixel column whose loudest peak-hold bin is above the
+// display floor. The bass columns come from the multirate stages, already
+// reduced to columns by the analysis thread. Returns the mark count.
+int build_peak_hold_marks(const DisplayFrame* frame, int channel, SDL_Rect rect, SDL_Rect* marks) {
+    FreqAxis* axis = &AppState.spectrum_axis;
+    if (!freq_axis_update(axis, frame->fft_size, AppState.sample_rate, rect.w)) return 0;
+    freq_axis_column_max(axis, frame->peak_hold[channel], -1000.0, AppState.column_peak_hold);
+    int low_columns = frame->low_columns < rect.w ? frame->low_columns : rect.w;
+    memcpy(AppState.column_peak_hold, frame->low_peak_hold[channel], low_columns * sizeof(double));
+
+    double db_range = SPECTRUM_DB_TOP - SPECTRUM_DB_FLOOR;
+    int count = 0;
+    for (int c = 0; c < rect.w; ++c) {
+        double db = AppState.column_peak_hold[c];
+        if (db <= SPECTRUM_DB_FLOOR) continue;
+        double mag_scaled = (db - SPECTRUM_DB_FLOOR) / db_range;
+        if (mag_scaled > 1.0) mag_scaled = 1.0;
+        int bar_height = (int)(mag_scaled * rect.h * AppState.visual_gain);
+        marks[count++] = (SDL_Rect){ rect.x + c, rect.y + rect.h - bar_height, 1, 2 };
+    }
+    return count;
+}
+
+// Height of a dB level in a spectrum lane, on the same scale as the
+// peak-hold marks.
+static inline int spectrum_y(SDL_Rect lane, double db) {
+    double scaled = (db - SPECTRUM_DB_FLOOR) / (SPECTRUM_DB_TOP - SPECTRUM_DB_FLOOR);
+    if (scaled < 0.0) scaled = 0.0;
+    if (scaled > 1.0) scaled = 1.0;
+    return lane.y + lane.h - (int)(scaled * lane.h * AppState.visual_gain);
+}
+
+// Channel 0's average as a line inside a band one standard deviation
+// either side of it, and its minimum as a dimmer line. Columns no bin
+// falls in are skipped.
+void draw_average(const DisplayFrame* frame, SDL_Rect lane) {
+    int points = 0, bands = 0;
+    for (int c = 0; c < lane.w; ++c) {
+        double db = frame->average_columns[c];
+        if (db <= -1000.0) continue;
+        int top = spectrum_y(lane, db + frame->deviation_columns[c]);
+        int bottom = spectrum_y(lane, db - frame->deviation_columns[c]);
+        AppState.average_points[points++] = (SDL_Point){ lane.x + c, spectrum_y(lane, db) };
+        if (bottom > top) AppState.deviation_bands[bands++] = (SDL_Rect){ lane.x + c, top, 1, bottom - top };
+    }
+    SDL_SetRenderDrawBlendMode(AppState.renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(AppState.renderer, 0, 200, 255, 50);
+    SDL_RenderFillRects(AppState.renderer, AppState.deviation_bands, bands);
+    SDL_SetRenderDrawBlendMode(AppState.renderer, SDL_BLENDMODE_NONE);
+    SDL_SetRenderDrawColor(AppState.renderer, 0, 200, 255, 255);
+    SDL_RenderDrawLines(AppState.renderer, AppState.average_points, points);
+
+    points = 0;
+    for (int c = 0; c < lane.w; ++c) {
+        if (frame->min_columns[c] <= -1000.0) continue;
+        AppState.average_points[points++] = (SDL_Point){ lane.x + c, spectrum_y(lane, frame->min_columns[c]) };
+    }
+    SDL_SetRenderDrawColor(AppState.renderer, 110, 110, 150, 255);
+    SDL_RenderDrawLines(AppState.renderer, AppState.average_points, points);
+}
+
+// The part of a panel a channel draws in: all of it when overlaid, or an
+// equal horizontal strip when stacked.
+SDL_Rect channel_lane(SDL_Rect panel, int channel, int channels) {
+    if (AppState.channel_layout == CHANNELS_OVERLAY || channels <= 1) return panel;
+    SDL_Rect lane = panel;
+    lane.y = panel.y + channel * panel.h / channels;
+    lane.h = (channel + 1) * panel.h / channels - channel * panel.h / channels;
+    return lane;
+}
+
+// Mono keeps the classic trace colours; multi-channel views colour each
+// channel from a fixed palette so overlaid traces stay distinguishable.
+SDL_Color channel_color(int channel, int channels, SDL_Color mono) {
+    static const SDL_Color palette[MAX_CHANNELS] = {
+        {230, 230, 240, 255}, {255, 80, 110, 255}, {80, 200, 255, 255}, {255, 190, 60, 255},
+        {120, 255, 120, 255}, {220, 120, 255, 255}, {255, 255, 120, 255}, {90, 230, 210, 255}
+    };
+    return channels <= 1 ? mono : palette[channel];
+}
+
+// Everything that only changes with the layout: the cleared backdrop, the
+// panels and their titles, both graticules and the divider.
+void draw_background() {
+    SDL_SetRenderDrawColor(AppState.renderer, 20, 22, 25, 255);
+    SDL_RenderClear(AppState.renderer);
+    draw_panel("OSCILLOSCOPE", AppState.scope_panel_rect);
+    draw_panel("SPECTRUM ANALYZER", AppState.spectrum_panel_rect);
+    draw_scope_graticule();
+    draw_spectrum_graticule();
+    SDL_SetRenderDrawColor(AppState.renderer, 255, 255, 255, 100);
+    SDL_RenderDrawLine(AppState.renderer, 0, 300, SCREEN_WIDTH, 300);
+}
+
+// Renders draw_background() into a target texture once, so a frame starts
+// with a single copy instead of dozens of fills and lines. Rebuilt when the
+// output size changes or the renderer drops its targets. If render targets
+// are unsupported the texture stays NULL and the chrome is drawn directly.
+void update_background() {
+    if (!AppState.background_dirty) return;
+    AppState.background_dirty = 0;
+    int w, h;
+    if (SDL_GetRendererOutputSize(AppState.renderer, &w, &h) != 0) { w = SCREEN_WIDTH; h = SCREEN_HEIGHT; }
+    if (AppState.background) {
+        int old_w, old_h;
+        SDL_QueryTexture(AppState.background, NULL, NULL, &old_w, &old_h);
+        if (old_w != w || old_h != h) { SDL_DestroyTexture(AppState.background); AppState.background = NULL; }
+    }
+    if (!AppState.background) {
+        AppState.background = SDL_CreateTexture(AppState.renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, w, h);
+        if (!AppState.background) return;
+        SDL_SetTextureBlendMode(AppState.background, SDL_BLENDMODE_NONE);
+    }
+    if (SDL_SetRenderTarget(AppState.renderer, AppState.background) != 0) {
+        SDL_DestroyTexture(AppState.background);
+        AppState.background = NULL;
+        return;
+    }
+    draw_background();
+    SDL_SetRenderTarget(AppState.renderer, NULL);
+}
+
+// Analysis thread: applies settings from the UI, runs the STFT over newly
+// captured audio and publishes one DisplayFrame per pass. It never waits on
+// the renderer, and the renderer never waits on it.
+int analysis_thread(void* data) {
+    Analyzer* an = &AppState.analyzers[0];
+    int peak_resets_seen = SDL_AtomicGet(&AppState.settings.peak_reset_count);
+    int average_mode_seen = AVERAGE_OFF;
+    while (SDL_AtomicGet(&AppState.analysis_running)) {
+        SDL_SemWaitTimeout(AppState.capture_ready, 50);
+        Uint64 frames_before = an->frame_count;
+        Uint32 stamp = (Uint32)SDL_AtomicGet(&AppState.capture_stamp_us);
+        int changed = 0;
+
+        int fft_size = SDL_AtomicGet(&AppState.settings.fft_size);
+        int hop_size = SDL_AtomicGet(&AppState.settings.hop_size);
+        int peak_resets = SDL_AtomicGet(&AppState.settings.peak_reset_count);
+        int average_mode = SDL_AtomicGet(&AppState.settings.average_mode);
+        for (int c = 0; c < AppState.channels; ++c) {
+            Analyzer* channel = &AppState.analyzers[c];
+            if (fft_size != channel->fft->size && analyzer_set_fft_size(channel, fft_size)) changed = 1;
+            if (hop_size != channel->hop_size) { analyzer_set_hop_size(channel, hop_size); changed = 1; }
+            if (peak_resets != peak_resets_seen) {
+                analyzer_reset_peak_hold(channel);
+                analyzer_reset_average(channel);
+                multirate_reset_peak_hold(&AppState.multirate[c]);
+                changed = 1;
+            }
+            if (average_mode != average_mode_seen) {
+                if (!analyzer_set_averaging(channel, (AverageMode)average_mode, AppState.average_frames, AppState.average_time)) {
+                    fprintf(stderr, "Not enough memory to average %d frames\n", AppState.average_frames);
+                }
+                changed = 1;
+            }
+            channel->squelch_threshold = SDL_AtomicGet(&AppState.settings.squelch);
+            channel->pitch_on = c == 0 && SDL_AtomicGet(&AppState.settings.pitch_on);
+            multirate_configure(&AppState.multirate[c], channel->fft->size, channel->hop_size, channel->squelch_threshold);
+        }
+        peak_resets_seen = peak_resets;
+        average_mode_seen = average_mode;
+        trigger_configure(&AppState.trigger, SDL_AtomicGet(&AppState.settings.trigger_level), AppState.trigger_hysteresis,
+                          (TriggerSlope)SDL_AtomicGet(&AppState.settings.trigger_slope),
+                          (int)(AppState.trigger_holdoff_ms * AppState.sample_rate / 1000.0));
+
+        Uint64 pass_start = SDL_GetPerformanceCounter();
+        process_capture();
+        if (an->frame_count != frames_before) {
+            perf_mark(&AppState.dsp_perf[PERF_DSP_PASS - PERF_DSP_FIRST], &pass_start);
+            AppState.frame_stamp_us = stamp;
+        }
+
+        Uint32 now = clock_us();
+        if ((Uint32)(now - AppState.dsp_window_start_us) >= PERF_WINDOW_US) {
+            AppState.dsp_window_start_us = now;
+            memcpy(AppState.dsp_perf_done, AppState.dsp_perf, sizeof(AppState.dsp_perf));
+            for (int i = 0; i < PERF_DSP_COUNT; ++i) perf_hist_reset(&AppState.dsp_perf[i]);
+            changed = 1;
+        }
+        if (changed || an->frame_count != frames_before) publish_display_frame();
+    }
+    return 0;
+}
+
+// Runs the STFT of every channel over everything the callback has queued,
+// so each hop is analysed exactly once however often the display refreshes.
+// Channels are read in equal counts, which keeps their analyzers in step.
+void process_capture() {
+    const int channels = AppState.channels;
+    Sint16 block[REC_BUFFER_SIZE];
+    for (;;) {
+        int count = REC_BUFFER_SIZE;
+        for (int c = 0; c < channels; ++c) {
+            int available = sample_ring_available(&AppState.capture_rings[c]);
+            if (available < count) count = available;
+        }
+        if (count <= 0) break;
+
+        for (int c = 0; c < channels; ++c) {
+            Sint16* rec_buffer = AppState.rec_buffers[c];
+            sample_ring_read(&AppState.capture_rings[c], block, count);
+            memmove(rec_buffer, rec_buffer + count, (REC_BUFFER_SIZE - count) * sizeof(Sint16));
+            memcpy(rec_buffer + REC_BUFFER_SIZE - count, block, count * sizeof(Sint16));
+            if (c == 0) trigger_scan(&AppState.trigger, block, count);
+
+            for (int used = 0; used < count; ) {
+                int frame_ready;
+                Uint64 feed_start = SDL_GetPerformanceCounter();
+                used += analyzer_feed(&AppState.analyzers[c], block + used, count - used, &frame_ready);
+                if (frame_ready) perf_mark(&AppState.dsp_perf[PERF_DSP_FRAME - PERF_DSP_FIRST], &feed_start);
+                if (frame_ready && c == 0) on_analysis_frame();
+                if (frame_ready) netstream_publish(&AppState.stream, c, &AppState.analyzers[c]);
+            }
+            multirate_feed(&AppState.multirate[c], block, count);
+        }
+    }
+
+    // Channel 0 is the trigger source, and every channel is shown from the
+    // same offset so overlaid traces stay time-aligned. A trace starts at
+    // the newest trigger with a whole screen of samples after it; without
+    // one it shows the newest samples, or in normal mode the last trace.
+    const Sint64 newest = (Sint64)AppState.trigger.position;
+    const Sint64 oldest = newest - REC_BUFFER_SIZE;
+    const int shown = AppState.scope_display_samples;
+    TriggerMode mode = (TriggerMode)SDL_AtomicGet(&AppState.settings.trigger_mode);
+    Uint64 position;
+    int triggered = mode != TRIGGER_OFF && newest - shown >= 0 &&
+                    trigger_find(&AppState.trigger, oldest > 0 ? (Uint64)oldest : 0, (Uint64)(newest - shown), &position);
+    if (triggered || mode != TRIGGER_NORMAL) {
+        AppState.trigger_offset = triggered ? (int)((Sint64)position - oldest) : REC_BUFFER_SIZE - shown;
+        AppState.scope_view_samples = shown;
+        memcpy(AppState.scope_view, AppState.rec_buffers, channels * sizeof(AppState.scope_view[0]));
+    }
+}
+
+// The waterfall sits in the scope panel below its title, on the same
+// columns as the spectrum underneath.
+SDL_Rect waterfall_rect() {
+    SDL_Rect rect = AppState.scope_panel_rect;
+    return (SDL_Rect){AppState.spectrum_panel_rect.x, rect.y + 20, AppState.spectrum_panel_rect.w, rect.h - 21};
+}
+
+// Turns channel 0's newest spectrum into one waterfall row: the loudest
+// bin of each pixel column, over the spectrum view's dB range.
+// Squelched hops give a blank row so the time axis keeps moving.
+void push_waterfall_row() {
+    const Analyzer* an = &AppState.analyzers[0];
+    RowRing* rows = &AppState.waterfall_rows;
+    Uint8* row = row_ring_begin(rows);
+    if (!row) return;
+    if (an->active && freq_axis_update(&AppState.marker_axis, an->fft->size, AppState.sample_rate, rows->width)) {
+        freq_axis_column_max(&AppState.marker_axis, an->magnitude_db, SPECTRUM_DB_FLOOR, AppState.waterfall_columns);
+        for (int x = 0; x < rows->width; ++x) {
+            double level = (AppState.waterfall_columns[x] - SPECTRUM_DB_FLOOR) * (255.0 / (SPECTRUM_DB_TOP - SPECTRUM_DB_FLOOR));
+            row[x] = level <= 0.0 ? 0 : level >= 255.0 ? 255 : (Uint8)level;
+        }
+    } else {
+        memset(row, 0, rows->width);
+    }
+    row_ring_commit(rows);
+    if (row_ring_count(rows) >= WATERFALL_RING_HIGH_WATER) wake_ui(&AppState.rows_event_pending, UI_WAKE_ROWS);
+}
+
+// Updates the peak marker and auto-timebase from the frame just analysed.
+// Bass peaks are re-measured on the multirate stages, whose bins are fine
+// enough to name the note. With pitch tracking on, a voiced frame names
+// its fundamental instead, which need not be the loudest partial.
+void on_analysis_frame() {
+    const Analyzer* an = &AppState.analyzers[0];
+    if (SDL_AtomicGet(&AppState.settings.waterfall_on)) push_waterfall_row();
+    if (an->active) {
+        double peak_freq = multirate_refine_peak(&AppState.multirate[0], an->peak_freq);
+        double target_freq = an->pitch_freq > 0.0 ? an->pitch_freq : peak_freq;
+
+        if (SDL_AtomicGet(&AppState.settings.auto_timebase_on)) {
+            int target_samples = (target_freq > 0) ? (4.0 * (AppState.sample_rate / target_freq)) : 2048;
+            if (target_samples < 100) target_samples = 100;
+            if (target_samples > REC_BUFFER_SIZE) target_samples = REC_BUFFER_SIZE;
+            AppState.scope_display_samples = (0.95 * AppState.scope_display_samples) + (0.05 * target_samples);
+        } else {
+            AppState.scope_display_samples = 2048;
+        }
+
+        double target_x = AppState.spectrum_panel_rect.x + freq_axis_position(peak_freq, AppState.sample_rate / 2.0, AppState.spectrum_panel_rect.w);
+
+        AppState.peak_marker.x_pos = (0.7 * AppState.peak_marker.x_pos) + (0.3 * target_x);
+        AppState.peak_marker.db = (0.7 * AppState.peak_marker.db) + (0.3 * an->peak_db);
+        AppState.peak_marker.frequency = target_freq;
+    } else {
+        AppState.peak_marker.db *= 0.99;
+        if (AppState.peak_marker.db < SPECTRUM_DB_FLOOR) { AppState.peak_marker.db = SPECTRUM_DB_FLOOR; AppState.peak_marker.frequency = 0.0; }
+    }
+}
+
+// Copies the analysis thread's view into the back slot and swaps it with
+// the middle one, marking it fresh for the renderer.
+void publish_display_frame() {
+    const Analyzer* an = &AppState.analyzers[0];
+    DisplayFrame* frame = &AppState.display_frames[AppState.display_back];
+    frame->frame_count = an->frame_count;
+    frame->fft_size = an->fft->size;
+    frame->hop_size = an->hop_size;
+    frame->trigger_offset = AppState.trigger_offset;
+    frame->scope_display_samples = AppState.scope_view_samples;
+    frame->peak_marker = AppState.peak_marker;
+    frame->capture_stamp_us = AppState.frame_stamp_us;
+    frame->channels = AppState.channels;
+    frame->active = 0;
+    memcpy(frame->dsp_perf, AppState.dsp_perf_done, sizeof(frame->dsp_perf));
+    for (int c = 0; c < AppState.channels; ++c) {
+        memcpy(frame->scope[c], AppState.scope_view[c], sizeof(frame->scope[c]));
+        memcpy(frame->peak_hold[c], AppState.analyzers[c].peak_hold, (an->fft->size / 2) * sizeof(double));
+        frame->low_columns = multirate_column_max(&AppState.multirate[c], AppState.spectrum_panel_rect.w, -1000.0, frame->low_peak_hold[c]);
+        frame->active |= AppState.analyzers[c].active;
+    }
+
+    // Averages are reduced to columns here, which costs three passes over
+    // the bins instead of copying three more bin arrays per frame.
+    const SpectrumAverage* av = &an->average;
+    frame->average_on = av->mode != AVERAGE_OFF && av->count > 0 &&
+                        freq_axis_update(&AppState.marker_axis, an->fft->size, AppState.sample_rate, AppState.spectrum_panel_rect.w);
+    if (frame->average_on) {
+        freq_axis_column_max(&AppState.marker_axis, av->level_db, -1000.0, frame->average_columns);
+        freq_axis_column_max(&AppState.marker_axis, av->deviation_db, 0.0, frame->deviation_columns);
+        freq_axis_column_max(&AppState.marker_axis, av->min_db, -1000.0, frame->min_columns);
+    }
+    SDL_AtomicSet(&AppState.latest_active, frame->active);
+    SDL_MemoryBarrierRelease();
+    AppState.display_back = SDL_AtomicSet(&AppState.display_middle, AppState.display_back | DISPLAY_FRAME_FRESH) & 3;
+
+    // One wake-up at a time: until the UI draws, later frames only replace
+    // the fresh slot, and the queue never fills with stale notifications.
+    wake_ui(&AppState.frame_event_pending, UI_WAKE_FRAME);
+}
+
+// Pushes a frame_event with `code`, unless one is outstanding on `pending`.
+void wake_ui(SDL_atomic_t* pending, int code) {
+    if (AppState.frame_event == (Uint32)-1 || !SDL_AtomicCAS(pending, 0, 1)) return;
+    SDL_Event e;
+    SDL_zero(e);
+    e.type = AppState.frame_event;
+    e.user.code = code;
+    SDL_PushEvent(&e);
+}
+
+// Returns the newest published frame. The front slot stays valid until the
+// next call, since the analysis thread only ever writes the back slot.
+const DisplayFrame* latest_display_frame() {
+    if (SDL_AtomicGet(&AppState.display_middle) & DISPLAY_FRAME_FRESH) {
+        AppState.display_front = SDL_AtomicSet(&AppState.display_middle, AppState.display_front) & 3;
+        SDL_MemoryBarrierAcquire();
+    }
+    return &AppState.display_frames[AppState.display_front];
+}
+
+// Milliseconds until the screen is next worth drawing, 0 if it is now.
+// Input redraws at the target rate, as do new frames while the input is
+// live; paused or squelched, new frames wait for the idle rate, which
+// also keeps clocks such as the recording time moving with no frames.
+Uint32 redraw_wait_ms() {
+    const Uint32 busy_ms = AppState.target_fps > 0 ? 1000 / AppState.target_fps : 0;
+    const int fresh = SDL_AtomicGet(&AppState.display_middle) & DISPLAY_FRAME_FRESH;
+    // The newest frame, not the one on screen, so returning signal is
+    // drawn at once instead of after an idle interval.
+    const int live = !AppState.is_paused && SDL_AtomicGet(&AppState.latest_active);
+    const Uint32 interval = AppState.ui_dirty || (fresh && live) ? busy_ms : 1000u / (Uint32)AppState.idle_fps;
+    const Uint32 since = SDL_GetTicks() - AppState.last_redraw_ms;
+    return since >= interval ? 0 : interval - since;
+}
+
+void publish_analysis_settings() {
+    SDL_AtomicSet(&AppState.settings.squelch, (int)AppState.squelch_threshold);
+    SDL_AtomicSet(&AppState.settings.trigger_mode, AppState.trigger_mode);
+    SDL_AtomicSet(&AppState.settings.trigger_slope, AppState.trigger_slope);
+    SDL_AtomicSet(&AppState.settings.trigger_level, AppState.trigger_level);
+    SDL_AtomicSet(&AppState.settings.auto_timebase_on, AppState.auto_timebase_on);
+    SDL_AtomicSet(&AppState.settings.waterfall_on, AppState.waterfall_on);
+    SDL_AtomicSet(&AppState.settings.pitch_on, AppState.pitch_on);
+    SDL_AtomicSet(&AppState.settings.average_mode, AppState.average_mode);
+}
+
+// Changes the FFT size and scales the hop with it, keeping the overlap.
+void request_fft_size(int size) {
+    if (!fft_size_is_valid(size)) return;
+    int old_size = SDL_AtomicGet(&AppState.settings.fft_size);
+    int hop_size = (int)((double)SDL_AtomicGet(&AppState.settings.hop_size) * size / old_size);
+    SDL_AtomicSet(&AppState.settings.hop_size, hop_size < 1 ? 1 : hop_size);
+    SDL_AtomicSet(&AppState.settings.fft_size, size);
+}
+
+// Steps through 0%, 50%, 75% and 87.5% overlap.
+void cycle_overlap() {
+    int fft_size = SDL_AtomicGet(&AppState.settings.fft_size);
+    int divisor = fft_size / SDL_AtomicGet(&AppState.settings.hop_size);
+    divisor = divisor >= 8 ? 1 : divisor * 2;
+    SDL_AtomicSet(&AppState.settings.hop_size, fft_size / divisor);
+}
+
+// Starts a recording of the analysed channels, to --record FILE the first
+// time and to a timestamped WAV in the working directory after that, or
+// finishes the one in progress.
+void toggle_recording() {
+    Recorder* rec = &AppState.recorder;
+    if (recorder_is_active(rec)) {
+        recorder_stop(rec, AppState.rec_device);
+        fprintf(report_stream(), "Recorded %d s to '%s', dropping %d blocks (%d frames) the disk could not keep up with\n",
+               SDL_AtomicGet(&rec->seconds), rec->path, SDL_AtomicGet(&rec->dropped_blocks), SDL_AtomicGet(&rec->dropped_frames));
+        return;
+    }
+    if (AppState.rec_device <= 0) return;
+    char path[64];
+    const char* target = AppState.record_path;
+    if (!target) {
+        time_t now = time(NULL);
+        strftime(path, sizeof(path), "alab-%Y%m%d-%H%M%S.wav", localtime(&now));
+        target = path;
     }
+    AppState.record_path = NULL;
+    recorder_start(rec, target, AppState.channels, (int)AppState.sample_rate);
 }
@@ -0,0 +1,202 @@
+/*
+ * multirate.c - Half-band decimator cascade and the per-octave analyzers.
+ */
+
+#include "multirate.h"
+#include <string.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define HALFBAND_CENTER (HALFBAND_TAPS / 2)
+#define HALFBAND_PAIRS ((HALFBAND_CENTER + 1) / 2)
+#define MULTIRATE_CHUNK 1024
+
+// Blackman-windowed sinc with its cutoff at a quarter of the input rate.
+// Even offsets from the centre are zero, so only the odd ones are kept:
+// coefficient j applies to offsets +-(2j + 1). The passband is flat to
+// well past the trusted quarter of the output rate, and the stopband,
+// which folds onto it when every other output is dropped, is down by
+// over 70 dB.
+static double halfband_coeffs[HALFBAND_PAIRS];
+static double halfband_centre;
+
+static void halfband_design() {
+    if (halfband_coeffs[0] != 0.0) return;
+    double sum = 0.5;
+    for (int j = 0; j < HALFBAND_PAIRS; ++j) {
+        int m = 2 * j + 1;
+        double x = M_PI * m / (HALFBAND_CENTER + 1);
+        double window = 0.42 + 0.5 * cos(x) + 0.08 * cos(2.0 * x);
+        halfband_coeffs[j] = sin(M_PI * m / 2.0) / (M_PI * m) * window;
+        sum += 2.0 * halfband_coeffs[j];
+    }
+    // Unity gain at DC.
+    for (int j = 0; j < HALFBAND_PAIRS; ++j) halfband_coeffs[j] /= sum;
+    halfband_centre = 0.5 / sum;
+}
+
+// Filters `count` inputs and writes every other output. Returns how many
+// outputs were written, count / 2 give or take the carried phase.
+static int halfband_run(HalfbandDecimator* d, const Sint16* in, int count, Sint16* out) {
+    int written = 0;
+    int pos = d->pos;
+    for (int i = 0; i < count; ++i) {
+        d->history[pos] = d->history[pos + HALFBAND_TAPS] = in[i];
+        pos = pos + 1 == HALFBAND_TAPS ? 0 : pos + 1;
+        d->phase ^= 1;
+        if (d->phase) continue;
+
+        // The newest HALFBAND_TAPS inputs sit contiguously from `pos`.
+        const double* window = d->history + pos;
+        double y = halfband_centre * window[HALFBAND_CENTER];
+        for (int j = 0; j < HALFBAND_PAIRS; ++j) {
+            y += halfband_coeffs[j] * (window[HALFBAND_CENTER - 1 - 2 * j] + window[HALFBAND_CENTER + 1 + 2 * j]);
+        }
+        out[written++] = y >= 32767.0 ? 32767 : y <= -32768.0 ? -32768 : (Sint16)lrint(y);
+    }
+    d->pos = pos;
+    return written;
+}
+
+// --- Stages ---
+
+static double stage_rate(const Multirate* mr, int k) {
+    return mr->sample_rate / (double)(2 << k);
+}
+
+static int stage_fft_size(const Multirate* mr, int k) {
+    int size = mr->fft_size;
+    while (size > MIN_FFT_SIZE && size / stage_rate(mr, k) > MULTIRATE_MAX_WINDOW) size /= 2;
+    return size;
+}
+
+static int stage_hop_size(const Multirate* mr, int size) {
+    int hop = (int)((double)mr->hop_size * size / mr->fft_size);
+    return hop < 1 ? 1 : hop;
+}
+
+// Highest frequency a stage is trusted for.
+static double stage_limit(const Analyzer* an) {
+    return an->sample_rate / 4.0;
+}
+
+static double bin_width(const Analyzer* an) {
+    return an->sample_rate / an->fft->size;
+}
+
+int multirate_init(Multirate* mr, int stages, int fft_size, int hop_size, double sample_rate) {
+    memset(mr, 0, sizeof(*mr));
+    halfband_design();
+    if (stages < 0) stages = 0;
+    if (stages > MULTIRATE_MAX_STAGES) stages = MULTIRATE_MAX_STAGES;
+    mr->sample_rate = sample_rate;
+    mr->fft_size = fft_size;
+    mr->hop_size = hop_size;
+    for (int k = 0; k < stages; ++k) {
+        int size = stage_fft_size(mr, k);
+        if (!analyzer_init(&mr->analyzers[k], size, stage_hop_size(mr, size), stage_rate(mr, k))) {
+            multirate_free(mr);
+            return 0;
+        }
+        mr->stages = k + 1;
+        mr->enabled[k] = bin_width(&mr->analyzers[k]) < sample_rate / fft_size;
+    }
+    return 1;
+}
+
+void multirate_free(Multirate* mr) {
+    for (int k = 0; k < mr->stages; ++k) {
+        analyzer_free(&mr->analyzers[k]);
+        freq_axis_free(&mr->axes[k]);
+    }
+    mr->stages = 0;
+}
+
+void multirate_configure(Multirate* mr, int fft_size, int hop_size, double squelch_threshold) {
+    mr->fft_size = fft_size;
+    mr->hop_size = hop_size;
+    for (int k = 0; k < mr->stages; ++k) {
+        Analyzer* an = &mr->analyzers[k];
+        int size = stage_fft_size(mr, k);
+        if (size != an->fft->size) analyzer_set_fft_size(an, size);
+        int hop = stage_hop_size(mr, an->fft->size);
+        if (hop != an->hop_size) analyzer_set_hop_size(an, hop);
+        an->squelch_threshold = squelch_threshold;
+        mr->enabled[k] = bin_width(an) < mr->sample_rate / fft_size;
+    }
+}
+
+void multirate_reset_peak_hold(Multirate* mr) {
+    for (int k = 0; k < mr->stages; ++k) analyzer_reset_peak_hold(&mr->analyzers[k]);
+}
+
+void multirate_feed(Multirate* mr, const Sint16* samples, int count) {
+    Sint16 buffers[2][MULTIRATE_CHUNK / 2 + 1];
+    for (int done = 0; done < count; ) {
+        int n = count - done < MULTIRATE_CHUNK ? count - done : MULTIRATE_CHUNK;
+        const Sint16* in = samples + done;
+        done += n;
+
+        // Each stage decimates the previous stage's output in place of the
+        // input, so the chunk shrinks by half at every step.
+        for (int k = 0; k < mr->stages && n > 0; ++k) {
+            Sint16* out = buffers[k & 1];
+            n = halfband_run(&mr->decimators[k], in, n, out);
+            in = out;
+            if (!mr->enabled[k]) continue;
+            for (int used = 0; used < n; ) {
+                int frame_ready;
+                used += analyzer_feed(&mr->analyzers[k], out + used, n - used, &frame_ready);
+            }
+        }
+    }
+}
+
+// --- Display ---
+
+int multirate_column_max(Multirate* mr, int width, double floor, double* out) {
+    const double max_freq = mr->sample_rate / 2.0;
+    int low_columns = 0;
+
+    // Coarsest first, so each finer stage overwrites the columns it covers.
+    for (int k = 0; k < mr->stages; ++k) {
+        const Analyzer* an = &mr->analyzers[k];
+        FreqAxis* axis = &mr->axes[k];
+        if (!mr->enabled[k]) continue;
+        if (!freq_axis_update_range(axis, an->fft->size, an->sample_rate, max_freq, width)) continue;
+        int limit = (int)freq_axis_position(stage_limit(an), max_freq, width);
+        if (limit > width) limit = width;
+        for (int c = 0; c < limit; ++c) {
+            double best = floor;
+            for (int i = axis->column_start[c]; i < axis->column_start[c + 1]; ++i) {
+                if (an->peak_hold[i] > best) best = an->peak_hold[i];
+            }
+            out[c] = best;
+        }
+        if (limit > low_columns) low_columns = limit;
+    }
+    return low_columns;
+}
+
+double multirate_refine_peak(const Multirate* mr, double freq) {
+    const double coarse = mr->sample_rate / mr->fft_size;
+    for (int k = mr->stages - 1; k >= 0; --k) {
+        const Analyzer* an = &mr->analyzers[k];
+        if (!mr->enabled[k] || !an->active || freq + coarse >= stage_limit(an)) continue;
+
+        const double width = bin_width(an);
+        int lo = (int)((freq - coarse) / width);
+        int hi = (int)ceil((freq + coarse) / width);
+        if (lo < 1) lo = 1;
+        if (hi > an->fft->size / 2 - 1) hi = an->fft->size / 2 - 1;
+        int best = lo;
+        for (int i = lo + 1; i <= hi; ++i) {
+            if (an->magnitude_db[i] > an->magnitude_db[best]) best = i;
+        }
+        return (best + interpolate_peak(an->magnitude_db, an->fft->size / 2, best, NULL)) * width;
+    }
+    return freq;
+}
@@ -0,0 +1,77 @@
+/*
+ * multirate.h - Octave-band analysis for the bottom of the spectrum.
+ *
+ * One FFT gives the same bin width everywhere, which is far too coarse
+ * for bass on a log axis: at 4096 points and 44.1 kHz a bin is 10.8 Hz,
+ * wider than a semitone below about 180 Hz. Rather than run a much larger
+ * FFT over the whole band, the input is halved in rate again and again by
+ * a cascade of half-band decimators, and each stage runs its own Analyzer
+ * on its decimated stream. Stage k runs at sample_rate / 2^(k + 1), so an
+ * FFT of the same length has 2^(k + 1) times finer bins, and each stage
+ * costs about half as much as the one above it.
+ *
+ * A stage is only trusted below a quarter of its own rate, where the
+ * decimation filters leave the band untouched and nothing has aliased in.
+ * The display takes each column from the finest stage that covers it,
+ * which gives constant-Q-like resolution: long windows in the bass and the
+ * main analyzer's short ones everywhere else. The stages' levels are on the
+ * analyzer's size-independent scale (see analysis.h), so a stage whose
+ * FFT MULTIRATE_MAX_WINDOW has shortened splices onto its neighbours
+ * without a step.
+ */
+
+#ifndef MULTIRATE_H
+#define MULTIRATE_H
+
+#include <SDL.h>
+#include "analysis.h"
+#include "freqaxis.h"
+
+#define MULTIRATE_MAX_STAGES 6
+#define DEFAULT_MULTIRATE_STAGES 4
+#define HALFBAND_TAPS 31            // Odd taps other than the centre are zero.
+#define MULTIRATE_MAX_WINDOW 1.5    // Seconds; caps a stage's FFT length.
+
+typedef struct {
+    double history[2 * HALFBAND_TAPS];  // Mirrored ring of the newest inputs.
+    int pos;
+    int phase;                          // Inputs since the last output, 0 or 1.
+} HalfbandDecimator;
+
+typedef struct {
+    int stages;
+    double sample_rate;                 // Rate of the undecimated input.
+    int fft_size;                       // Main analyzer's size and hop, which
+    int hop_size;                       // the stages are derived from.
+    HalfbandDecimator decimators[MULTIRATE_MAX_STAGES];
+    Analyzer analyzers[MULTIRATE_MAX_STAGES];   // Stage k at sample_rate / 2^(k + 1).
+    int enabled[MULTIRATE_MAX_STAGES];  // Bins finer than the main analyzer's.
+    FreqAxis axes[MULTIRATE_MAX_STAGES];
+} Multirate;
+
+// Sets up `stages` (0..MULTIRATE_MAX_STAGES) stages below a main analyzer
+// of fft_size and hop_size. Returns 0 on allocation failure.
+int multirate_init(Multirate* mr, int stages, int fft_size, int hop_size, double sample_rate);
+void multirate_free(Multirate* mr);
+
+// Follows a change of the main analyzer's size or hop. Each stage keeps
+// the main overlap ratio, and its FFT is as long as the main one unless
+// that would make its window longer than MULTIRATE_MAX_WINDOW.
+void multirate_configure(Multirate* mr, int fft_size, int hop_size, double squelch_threshold);
+void multirate_reset_peak_hold(Multirate* mr);
+
+// Decimates and analyses `count` samples of the main analyzer's input.
+void multirate_feed(Multirate* mr, const Sint16* samples, int count);
+
+// Writes the stages' peak hold for the low columns of a full-band log
+// axis `width` pixels wide, each column from the finest stage that covers
+// it, or `floor` where no bin falls in it. Returns how many leading
+// columns were written; the rest belong to the main analyzer.
+int multirate_column_max(Multirate* mr, int width, double floor, double* out);
+
+// Refines a peak the main analyzer found at `freq`, searching one main bin
+// either side in the finest active stage that covers it. Returns `freq`
+// unchanged when no stage does.
+double multirate_refine_peak(const Multirate* mr, double freq);
+
+#endif
@@ -0,0 +1,179 @@
+/*
+ * netstream.c - Spectrum frame serialisation and UDP fan-out.
+ */
+
+#include "netstream.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#define INVALID_STREAM_SOCKET INVALID_SOCKET
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#define INVALID_STREAM_SOCKET -1
+#endif
+
+#define RMS_FLOOR_DBFS -120.0
+
+static void write_le32(Uint8* p, Uint32 v) { p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24; }
+static void write_le16(Uint8* p, Uint16 v) { p[0] = v; p[1] = v >> 8; }
+
+static void write_f32(Uint8* p, double v) {
+    float f = (float)v;
+    Uint32 bits;
+    memcpy(&bits, &f, sizeof(bits));
+    write_le32(p, bits);
+}
+
+// --- Sockets ---
+
+int netstream_open(NetStream* ns, int bits, int ttl) {
+    memset(ns, 0, sizeof(*ns));
+    ns->socket = INVALID_STREAM_SOCKET;
+    ns->bits = bits == 8 ? 8 : 16;
+    ns->packets = malloc(NETSTREAM_MAX_PACKETS * NETSTREAM_PACKET_BYTES);
+    if (!ns->packets) return 0;
+
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        fprintf(stderr, "Could not start Winsock\n");
+        netstream_close(ns);
+        return 0;
+    }
+    SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    u_long non_blocking = 1;
+    if (s == INVALID_SOCKET || ioctlsocket(s, FIONBIO, &non_blocking) != 0) {
+#else
+    int s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s < 0 || fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK) != 0) {
+#endif
+        fprintf(stderr, "Could not open a UDP socket for streaming\n");
+        ns->socket = s;
+        netstream_close(ns);
+        return 0;
+    }
+    ns->socket = s;
+    setsockopt(s, IPPROTO_IP, IP_MULTICAST_TTL, (const char*)&ttl, sizeof(ttl));
+    return 1;
+}
+
+void netstream_close(NetStream* ns) {
+    if (ns->socket != INVALID_STREAM_SOCKET) {
+#ifdef _WIN32
+        closesocket(ns->socket);
+        WSACleanup();
+#else
+        close(ns->socket);
+#endif
+    }
+    ns->socket = INVALID_STREAM_SOCKET;
+    free(ns->packets);
+    ns->packets = NULL;
+}
+
+int netstream_add_target(NetStream* ns, const char* spec) {
+    if (ns->target_count == NETSTREAM_MAX_TARGETS) {
+        fprintf(stderr, "At most %d stream targets are supported\n", NETSTREAM_MAX_TARGETS);
+        return 0;
+    }
+    char host[256];
+    const char* colon = strrchr(spec, ':');
+    if (!colon || colon == spec || (size_t)(colon - spec) >= sizeof(host) || atoi(colon + 1) <= 0) {
+        fprintf(stderr, "Stream target '%s' must be HOST:PORT\n", spec);
+        return 0;
+    }
+    memcpy(host, spec, colon - spec);
+    host[colon - spec] = '\0';
+
+    struct addrinfo hints, *found;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo(host, colon + 1, &hints, &found) != 0 || found->ai_addrlen > sizeof(ns->targets[0].address)) {
+        fprintf(stderr, "Could not resolve stream target '%s'\n", spec);
+        return 0;
+    }
+    memcpy(ns->targets[ns->target_count].address, found->ai_addr, found->ai_addrlen);
+    ns->targets[ns->target_count].length = (int)found->ai_addrlen;
+    ns->target_count++;
+    freeaddrinfo(found);
+    return 1;
+}
+
+// --- Frames ---
+
+static int quantise_bins(const NetStream* ns, const double* db, int count, Uint8* out) {
+    if (ns->bits == 8) {
+        for (int i = 0; i < count; ++i) {
+            double code = (db[i] - FULL_SCALE_DB + NETSTREAM_OFFSET_DB_8) * 2.0;
+            out[i] = code <= 0.0 ? 0 : code >= 255.0 ? 255 : (Uint8)lrint(code);
+        }
+        return count;
+    }
+    for (int i = 0; i < count; ++i) {
+        double code = (db[i] - FULL_SCALE_DB + NETSTREAM_OFFSET_DB_16) * 256.0;
+        write_le16(out + 2 * i, code <= 0.0 ? 0 : code >= 65535.0 ? 65535 : (Uint16)lrint(code));
+    }
+    return 2 * count;
+}
+
+// Writes the frame into ns->packets and returns how many packets it took.
+static int serialise_frame(NetStream* ns, int channel, const Analyzer* an) {
+    const int bins = an->active ? an->fft->size / 2 : 0;
+    const int per_packet = (NETSTREAM_PACKET_BYTES - NETSTREAM_HEADER_BYTES) / (ns->bits / 8);
+    const int packets = bins > 0 ? (bins + per_packet - 1) / per_packet : 1;
+    const double rms_dbfs = an->rms > 0.0 ? 20.0 * log10(an->rms / 32768.0) : RMS_FLOOR_DBFS;
+
+    // The header is identical across the frame's packets except for where
+    // the bins start, so it is filled in once and copied.
+    Uint8 header[NETSTREAM_HEADER_BYTES];
+    memset(header, 0, sizeof(header));
+    memcpy(header, "ALSF", 4);
+    header[4] = NETSTREAM_VERSION;
+    header[5] = (Uint8)ns->bits;
+    header[6] = (Uint8)channel;
+    header[7] = an->active ? NETSTREAM_ACTIVE : 0;
+    write_le32(header + 8, (Uint32)an->frame_count);
+    write_le32(header + 12, (Uint32)lrint(an->sample_rate));
+    write_le32(header + 16, (Uint32)an->fft->size);
+    write_f32(header + 20, an->active ? an->peak_freq : 0.0);
+    write_f32(header + 24, an->active ? an->peak_db - FULL_SCALE_DB : 0.0);
+    write_f32(header + 28, rms_dbfs < RMS_FLOOR_DBFS ? RMS_FLOOR_DBFS : rms_dbfs);
+    write_f32(header + 32, an->pitch_freq);
+    write_le16(header + 44, (Uint16)packets);
+
+    for (int p = 0; p < packets; ++p) {
+        Uint8* packet = ns->packets + p * NETSTREAM_PACKET_BYTES;
+        int first = p * per_packet;
+        int count = bins - first < per_packet ? bins - first : per_packet;
+        if (count < 0) count = 0;
+        memcpy(packet, header, NETSTREAM_HEADER_BYTES);
+        write_le32(packet + 36, (Uint32)first);
+        write_le16(packet + 40, (Uint16)count);
+        write_le16(packet + 42, (Uint16)p);
+        ns->packet_sizes[p] = NETSTREAM_HEADER_BYTES + quantise_bins(ns, an->magnitude_db + first, count, packet + NETSTREAM_HEADER_BYTES);
+    }
+    return packets;
+}
+
+void netstream_publish(NetStream* ns, int channel, const Analyzer* an) {
+    if (ns->target_count == 0 || ns->socket == INVALID_STREAM_SOCKET) return;
+    const int packets = serialise_frame(ns, channel, an);
+    for (int t = 0; t < ns->target_count; ++t) {
+        const struct sockaddr* address = (const struct sockaddr*)ns->targets[t].address;
+        for (int p = 0; p < packets; ++p) {
+            const char* packet = (const char*)(ns->packets + p * NETSTREAM_PACKET_BYTES);
+            if (sendto(ns->socket, packet, ns->packet_sizes[p], 0, address, ns->targets[t].length) == ns->packet_sizes[p]) ns->packets_sent++;
+            else ns->packets_dropped++;
+        }
+    }
+    ns->frames++;
+}
@@ -0,0 +1,92 @@
+/*
+ * netstream.h - Spectrum frames over UDP, multicast or unicast.
+ *
+ * Every analysed hop of every channel is published as a run of UDP
+ * datagrams, each small enough to cross a 1500-byte MTU unfragmented.
+ * A frame is serialised once into a packet buffer and the same bytes go
+ * to every target, so the cost is one encode per frame however many
+ * viewers there are. A multicast group is a single target: the network,
+ * not this process, copies it to each subscriber.
+ *
+ * Packet layout, all fields little-endian:
+ *
+ *   0  "ALSF"           magic
+ *   4  u8  version      NETSTREAM_VERSION
+ *   5  u8  bits         8 or 16 per bin
+ *   6  u8  channel
+ *   7  u8  flags        NETSTREAM_ACTIVE when above the squelch
+ *   8  u32 sequence     the channel's frame count
+ *  12  u32 sample_rate  Hz
+ *  16  u32 fft_size
+ *  20  f32 peak_freq    Hz, interpolated
+ *  24  f32 peak_dbfs
+ *  28  f32 rms_dbfs
+ *  32  f32 pitch_freq   Hz, 0 when unvoiced or not tracked
+ *  36  u32 first_bin    of this packet's bins
+ *  40  u16 bin_count
+ *  42  u16 packet       index within the frame
+ *  44  u16 packets      in the frame
+ *  46  u16 reserved
+ *  48  bins             fft_size / 2 per frame, split across the packets
+ *
+ * Levels are dBFS, a full-scale sine peaking at 0 whatever the FFT size.
+ * A bin code is its level plus NETSTREAM_OFFSET_DB_8 times 2 for 8 bits
+ * (0.5 dB steps from -120 to +7.5 dBFS) or plus NETSTREAM_OFFSET_DB_16
+ * times 256 for 16 bits (1/256 dB steps from -200 to +56 dBFS), clamped
+ * to the code range. A squelched frame is one packet with no bins, so
+ * silence costs almost nothing.
+ */
+
+#ifndef NETSTREAM_H
+#define NETSTREAM_H
+
+#include <SDL.h>
+#include <stdint.h>
+#include "analysis.h"
+
+#define NETSTREAM_VERSION 2
+#define NETSTREAM_MAX_TARGETS 8
+#define NETSTREAM_HEADER_BYTES 48
+#define NETSTREAM_PACKET_BYTES 1400
+#define NETSTREAM_ACTIVE 0x01
+#define NETSTREAM_OFFSET_DB_8 120.0
+#define NETSTREAM_OFFSET_DB_16 200.0
+// At 16 bits a full-size frame takes MAX_FFT_SIZE bytes of bins.
+#define NETSTREAM_MAX_PACKETS (MAX_FFT_SIZE / (NETSTREAM_PACKET_BYTES - NETSTREAM_HEADER_BYTES) + 1)
+
+typedef struct {
+    int bits;                       // Per bin, 8 or 16.
+    int target_count;
+    struct {
+        Uint8 address[16];          // sockaddr_in, kept opaque here.
+        int length;
+    } targets[NETSTREAM_MAX_TARGETS];
+#ifdef _WIN32
+    uintptr_t socket;
+#else
+    int socket;
+#endif
+
+    Uint8* packets;                 // One whole serialised frame.
+    int packet_sizes[NETSTREAM_MAX_PACKETS];
+
+    // --- Totals ---
+    Uint64 frames;
+    Uint64 packets_sent;
+    Uint64 packets_dropped;         // Socket buffer full or the send failed.
+} NetStream;
+
+// Opens a non-blocking UDP socket. Datagrams to a multicast target live
+// for `ttl` router hops. Returns 0, with the reason on stderr, on failure.
+int netstream_open(NetStream* ns, int bits, int ttl);
+void netstream_close(NetStream* ns);
+
+// Resolves "HOST:PORT" into a new target. Returns 0, with the reason on
+// stderr, for a bad address or when NETSTREAM_MAX_TARGETS are in use.
+int netstream_add_target(NetStream* ns, const char* spec);
+
+// Serialises the analyzer's latest frame and sends it to every target.
+// Never blocks: a datagram the socket cannot take is counted as dropped.
+void netstream_publish(NetStream* ns, int channel, const Analyzer* an);
+
+#endif
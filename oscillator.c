@@ -0,0 +1,105 @@
+/*
+ * oscillator.c - Wavetable synthesis and the phase-accumulator oscillator.
+ */
+
+#include "oscillator.h"
+#include "fft.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define PHASE_FRAC_BITS (32 - WAVETABLE_BITS)
+#define PHASE_FRAC_MASK ((1u << PHASE_FRAC_BITS) - 1)
+
+// Fourier series of the generator's classic waveform shapes: the sine
+// coefficient (a) and cosine coefficient (b) of harmonic n.
+static void harmonic(WaveformType wave, int n, double* a, double* b) {
+    *a = 0.0; *b = 0.0;
+    switch (wave) {
+        case WAVE_SINE: if (n == 1) *a = 1.0; break;
+        case WAVE_SQUARE: if (n & 1) *a = 4.0 / (M_PI * n); break;
+        case WAVE_SAWTOOTH: *a = -2.0 / (M_PI * n); break;
+        case WAVE_TRIANGLE: if (n & 1) *b = 8.0 / (M_PI * M_PI * n * n); break;
+        default: break;
+    }
+}
+
+// Sums harmonics 1..count of `wave` into one cycle. With Y[n] = b + i*a,
+// the real part of the forward transform is sum(b cos + a sin), so one
+// FFT replaces WAVETABLE_SIZE * count sin() calls.
+static float* build_table(const FFTPlan* plan, Complex* work, WaveformType wave, int count) {
+    float* table = malloc((WAVETABLE_SIZE + 1) * sizeof(float));
+    if (!table) return NULL;
+    memset(work, 0, WAVETABLE_SIZE * sizeof(Complex));
+    for (int n = 1; n <= count; ++n) {
+        harmonic(wave, n, &work[n].imag, &work[n].real);
+    }
+    fft_forward(plan, work);
+    for (int i = 0; i < WAVETABLE_SIZE; ++i) table[i] = (float)work[i].real;
+    table[WAVETABLE_SIZE] = table[0];
+    return table;
+}
+
+int wavetables_init(Wavetables* tables) {
+    memset(tables, 0, sizeof(*tables));
+    FFTPlan* plan = fft_plan_create(WAVETABLE_SIZE);
+    Complex* work = malloc(WAVETABLE_SIZE * sizeof(Complex));
+    int ok = plan && work;
+
+    float* sine = ok ? build_table(plan, work, WAVE_SINE, 1) : NULL;
+    ok = ok && sine;
+    for (int level = 0; ok && level < WAVETABLE_LEVELS; ++level) {
+        tables->tables[WAVE_SINE][level] = sine;
+        for (int wave = WAVE_SQUARE; ok && wave < WAVE_COUNT; ++wave) {
+            tables->tables[wave][level] = build_table(plan, work, (WaveformType)wave, 1 << level);
+            ok = tables->tables[wave][level] != NULL;
+        }
+    }
+
+    fft_plan_destroy(plan);
+    free(work);
+    if (!ok) wavetables_free(tables);
+    return ok;
+}
+
+void wavetables_free(Wavetables* tables) {
+    free(tables->tables[WAVE_SINE][0]);
+    for (int wave = WAVE_SQUARE; wave < WAVE_COUNT; ++wave) {
+        for (int level = 0; level < WAVETABLE_LEVELS; ++level) free(tables->tables[wave][level]);
+    }
+    memset(tables, 0, sizeof(*tables));
+}
+
+void oscillator_set(Oscillator* osc, const Wavetables* tables, WaveformType wave, double freq, double sample_rate) {
+    double nyquist = sample_rate / 2.0;
+    if (freq < 0.0) freq = 0.0;
+    if (freq > nyquist) freq = nyquist;
+    osc->increment = (Uint32)(freq / sample_rate * 4294967296.0);
+
+    // Richest level whose 2^level harmonics all stay below Nyquist.
+    int level = 0;
+    if (freq > 0.0) {
+        double harmonics = nyquist / freq;
+        while (level + 1 < WAVETABLE_LEVELS && (double)(1 << (level + 1)) <= harmonics) ++level;
+    }
+    osc->table = tables->tables[wave][level];
+}
+
+void oscillator_render(Oscillator* osc, float* out, int n) {
+    const float* table = osc->table;
+    const Uint32 increment = osc->increment;
+    const float frac_scale = 1.0f / (float)(1u << PHASE_FRAC_BITS);
+    Uint32 phase = osc->phase;
+    for (int i = 0; i < n; ++i) {
+        Uint32 index = phase >> PHASE_FRAC_BITS;
+        float frac = (float)(phase & PHASE_FRAC_MASK) * frac_scale;
+        float a = table[index];
+        out[i] = a + (table[index + 1] - a) * frac;
+        phase += increment;
+    }
+    osc->phase = phase;
+}
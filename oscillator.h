@@ -0,0 +1,50 @@
+/*
+ * oscillator.h - Band-limited wavetable oscillators for the tone generator.
+ *
+ * Each waveform is stored as a set of single-cycle tables, one per octave
+ * of harmonic content: level L holds the first 2^L harmonics. An
+ * oscillator picks the richest level whose top harmonic stays below
+ * Nyquist, so square, saw and triangle tones do not alias at any pitch.
+ *
+ * Phase is a 32-bit integer accumulator that wraps for free, so long runs
+ * do not lose precision the way an accumulating double does. The top
+ * WAVETABLE_BITS select the table entry and the rest interpolate.
+ */
+
+#ifndef OSCILLATOR_H
+#define OSCILLATOR_H
+
+#include <SDL.h>
+
+#define WAVETABLE_BITS 12
+#define WAVETABLE_SIZE (1 << WAVETABLE_BITS)
+#define WAVETABLE_LEVELS 11     // Up to 1024 harmonics.
+
+typedef enum {
+    WAVE_SINE, WAVE_SQUARE, WAVE_SAWTOOTH, WAVE_TRIANGLE, WAVE_COUNT
+} WaveformType;
+
+typedef struct {
+    // WAVETABLE_SIZE + 1 samples each; the extra one repeats the first so
+    // interpolation never wraps. Sine has a single level shared by all.
+    float* tables[WAVE_COUNT][WAVETABLE_LEVELS];
+} Wavetables;
+
+typedef struct {
+    Uint32 phase;
+    Uint32 increment;
+    const float* table;
+} Oscillator;
+
+// Builds every table once. Returns 0 on allocation failure.
+int wavetables_init(Wavetables* tables);
+void wavetables_free(Wavetables* tables);
+
+// Sets the pitch and waveform, choosing the band-limited level for `freq`.
+// The phase carries on, so changing the pitch never clicks.
+void oscillator_set(Oscillator* osc, const Wavetables* tables, WaveformType wave, double freq, double sample_rate);
+
+// Writes `n` samples in [-1, 1] (plus band-limited overshoot) to `out`.
+void oscillator_render(Oscillator* osc, float* out, int n);
+
+#endif
@@ -0,0 +1,42 @@
+/*
+ * perfstats.c - Log-binned duration histograms.
+ */
+
+#include "perfstats.h"
+#include <string.h>
+#include <math.h>
+
+void perf_hist_reset(PerfHistogram* hist) {
+    memset(hist, 0, sizeof(*hist));
+}
+
+void perf_hist_add(PerfHistogram* hist, double us) {
+    int bin = us > 1.0 ? (int)(log2(us) * PERF_BINS_PER_OCTAVE) : 0;
+    if (bin >= PERF_BINS) bin = PERF_BINS - 1;
+    hist->bins[bin]++;
+    hist->count++;
+    hist->sum_us += us;
+    if (us > hist->max_us) hist->max_us = us;
+}
+
+double perf_hist_mean(const PerfHistogram* hist) {
+    return hist->count ? hist->sum_us / hist->count : 0.0;
+}
+
+double perf_bin_upper_us(int bin) {
+    return exp2((double)(bin + 1) / PERF_BINS_PER_OCTAVE);
+}
+
+double perf_hist_percentile(const PerfHistogram* hist, double p) {
+    if (hist->count == 0) return 0.0;
+    double target = p * hist->count;
+    Uint32 seen = 0;
+    for (int bin = 0; bin < PERF_BINS; ++bin) {
+        seen += hist->bins[bin];
+        if (seen > 0 && seen >= target) {
+            double upper = perf_bin_upper_us(bin);
+            return upper < hist->max_us ? upper : hist->max_us;
+        }
+    }
+    return hist->max_us;
+}
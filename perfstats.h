@@ -0,0 +1,38 @@
+/*
+ * perfstats.h - Duration histograms for the Audio Lab instrumentation.
+ *
+ * A histogram has log-spaced bins, PERF_BINS_PER_OCTAVE per octave from
+ * 1 us, so recording a sample is one log2() and an increment, and any
+ * percentile can be read back to within one bin (about 9%) without
+ * storing the samples. Callers keep one histogram per timed section and
+ * swap in a fresh one at the end of each reporting window.
+ */
+
+#ifndef PERFSTATS_H
+#define PERFSTATS_H
+
+#include <SDL.h>
+
+#define PERF_BINS_PER_OCTAVE 8
+#define PERF_BINS 160               // 1 us to about 1 s.
+#define PERF_WINDOW_US 1000000      // Reporting window.
+
+typedef struct {
+    Uint32 count;
+    double sum_us;
+    double max_us;
+    Uint32 bins[PERF_BINS];
+} PerfHistogram;
+
+void perf_hist_reset(PerfHistogram* hist);
+void perf_hist_add(PerfHistogram* hist, double us);
+double perf_hist_mean(const PerfHistogram* hist);
+
+// Upper edge of the bin holding the p-th fraction of samples (0..1),
+// capped at the largest sample. 0 for an empty histogram.
+double perf_hist_percentile(const PerfHistogram* hist, double p);
+
+// Upper edge in microseconds of `bin`.
+double perf_bin_upper_us(int bin);
+
+#endif
@@ -0,0 +1,275 @@
+/*
+ * recorder.c - Capture tap rings and the buffered WAV/raw writer thread.
+ */
+
+#define _FILE_OFFSET_BITS 64
+#include "recorder.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define RECORD_CHUNK 1024           // Frames interleaved per pass.
+#define RECORD_POLL_MS 100
+
+// A RIFF size field is 32 bits, so a WAV file stops short of 4 GiB.
+#define WAV_DATA_LIMIT (0xFFFFFFFFLL - RECORD_ALIGN)
+
+static void write_le32(Uint8* p, Uint32 v) { p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24; }
+static void write_le16(Uint8* p, Uint16 v) { p[0] = v; p[1] = v >> 8; }
+
+static int has_wav_extension(const char* path) {
+    size_t len = strlen(path);
+    if (len < 4) return 0;
+    const char* ext = path + len - 4;
+    return ext[0] == '.' && (ext[1] | 0x20) == 'w' && (ext[2] | 0x20) == 'a' && (ext[3] | 0x20) == 'v';
+}
+
+// RIFF and fmt chunks, then a JUNK chunk that pads the data chunk out to
+// start at RECORD_ALIGN. The sizes are patched when the file is closed.
+static void write_wav_header(Recorder* rec, Uint8* p) {
+    const int block_align = rec->channels * 2;
+    memset(p, 0, RECORD_ALIGN);
+    memcpy(p, "RIFF", 4);
+    memcpy(p + 8, "WAVE", 4);
+    memcpy(p + 12, "fmt ", 4);
+    write_le32(p + 16, 16);
+    write_le16(p + 20, 1);
+    write_le16(p + 22, (Uint16)rec->channels);
+    write_le32(p + 24, (Uint32)rec->sample_rate);
+    write_le32(p + 28, (Uint32)(rec->sample_rate * block_align));
+    write_le16(p + 32, (Uint16)block_align);
+    write_le16(p + 34, 16);
+    memcpy(p + 36, "JUNK", 4);
+    write_le32(p + 40, RECORD_ALIGN - 52);
+    memcpy(p + RECORD_ALIGN - 8, "data", 4);
+}
+
+// --- Platform file access ---
+
+static int sink_open(Recorder* rec) {
+#ifdef _WIN32
+    rec->file = fopen(rec->path, "wb");
+    if (!rec->file) return 0;
+    // Writes are already large; stdio's own buffer would only copy them.
+    setvbuf(rec->file, NULL, _IONBF, 0);
+#else
+    rec->fd = open(rec->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (rec->fd < 0) return 0;
+#endif
+    return 1;
+}
+
+static int sink_write(Recorder* rec, const Uint8* src, size_t len) {
+#ifdef _WIN32
+    return fwrite(src, 1, len, rec->file) == len;
+#else
+    while (len > 0) {
+        ssize_t n = write(rec->fd, src, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        src += n;
+        len -= (size_t)n;
+    }
+    return 1;
+#endif
+}
+
+static int sink_write_at(Recorder* rec, long long offset, const Uint8* src, size_t len) {
+#ifdef _WIN32
+    if (_fseeki64(rec->file, offset, SEEK_SET) != 0) return 0;
+    return fwrite(src, 1, len, rec->file) == len;
+#else
+    return pwrite(rec->fd, src, len, offset) == (ssize_t)len;
+#endif
+}
+
+static int sink_close(Recorder* rec) {
+#ifdef _WIN32
+    int ok = !rec->file || fclose(rec->file) == 0;
+    rec->file = NULL;
+#else
+    int ok = rec->fd < 0 || close(rec->fd) == 0;
+    rec->fd = -1;
+#endif
+    return ok;
+}
+
+// --- Writer Thread ---
+
+// Stops tapping and keeps the file as it stands. The thread carries on
+// draining the rings, discarding what it reads, until it is stopped.
+static void writer_fail(Recorder* rec, const char* reason) {
+    if (SDL_AtomicGet(&rec->failed)) return;
+    fprintf(stderr, "Recording to '%s' stopped: %s\n", rec->path, reason);
+    SDL_AtomicSet(&rec->failed, 1);
+    SDL_AtomicSet(&rec->active, 0);
+}
+
+static void writer_flush(Recorder* rec) {
+    if (rec->fill == 0 || SDL_AtomicGet(&rec->failed)) return;
+    if (!sink_write(rec, rec->buffer, rec->fill)) {
+        writer_fail(rec, strerror(errno));
+        return;
+    }
+    rec->file_bytes += rec->fill;
+    rec->fill = 0;
+}
+
+static void writer_append(Recorder* rec, const Sint16* frames, int count) {
+    const Uint8* src = (const Uint8*)frames;
+    size_t len = (size_t)count * rec->channels * sizeof(Sint16);
+    if (rec->wav && rec->file_bytes + (long long)(rec->fill + len) - RECORD_ALIGN > WAV_DATA_LIMIT) {
+        writer_fail(rec, "reached the 4 GiB WAV size limit, record to a .raw file for longer sessions");
+        return;
+    }
+    while (len > 0) {
+        size_t n = RECORD_WRITE_BYTES - rec->fill < len ? RECORD_WRITE_BYTES - rec->fill : len;
+        memcpy(rec->buffer + rec->fill, src, n);
+        rec->fill += n;
+        src += n;
+        len -= n;
+        if (rec->fill == RECORD_WRITE_BYTES) writer_flush(rec);
+        if (SDL_AtomicGet(&rec->failed)) return;
+    }
+    rec->frames += count;
+    SDL_AtomicSet(&rec->seconds, (int)(rec->frames / rec->sample_rate));
+}
+
+// Moves everything the rings hold into the write buffer. The rings are
+// read in equal counts, as the callback writes them.
+static void writer_drain(Recorder* rec) {
+    Sint16 block[RECORD_CHUNK];
+    Sint16 frames[RECORD_CHUNK * RECORD_MAX_CHANNELS];
+    for (;;) {
+        int count = RECORD_CHUNK;
+        for (int c = 0; c < rec->channels; ++c) {
+            int available = sample_ring_available(&rec->rings[c]);
+            if (available < count) count = available;
+        }
+        if (count == 0) return;
+        for (int c = 0; c < rec->channels; ++c) {
+            sample_ring_read(&rec->rings[c], block, count);
+            for (int i = 0; i < count; ++i) frames[i * rec->channels + c] = (Sint16)SDL_SwapLE16((Uint16)block[i]);
+        }
+        if (!SDL_AtomicGet(&rec->failed)) writer_append(rec, frames, count);
+    }
+}
+
+static int writer_thread(void* data) {
+    Recorder* rec = data;
+    for (;;) {
+        // Tapping has ended by the time `stopping` is set, so the drain
+        // after seeing it is the last one needed.
+        int stopping = SDL_AtomicGet(&rec->stopping);
+        writer_drain(rec);
+        if (stopping) break;
+        SDL_SemWaitTimeout(rec->wake, RECORD_POLL_MS);
+    }
+    writer_flush(rec);
+
+    if (rec->wav && rec->file_bytes >= RECORD_ALIGN) {
+        Uint8 size[4];
+        write_le32(size, (Uint32)(rec->file_bytes - 8));
+        int ok = sink_write_at(rec, 4, size, 4);
+        write_le32(size, (Uint32)(rec->file_bytes - RECORD_ALIGN));
+        ok = ok && sink_write_at(rec, RECORD_ALIGN - 4, size, 4);
+        if (!ok) fprintf(stderr, "Could not finalise the WAV header of '%s'\n", rec->path);
+    }
+    if (!sink_close(rec)) fprintf(stderr, "Could not close recording '%s': %s\n", rec->path, strerror(errno));
+    return 0;
+}
+
+// --- Lifetime ---
+
+static void recorder_release(Recorder* rec) {
+    sink_close(rec);
+    for (int c = 0; c < rec->channels; ++c) sample_ring_free(&rec->rings[c]);
+    free(rec->allocation);
+    rec->allocation = rec->buffer = NULL;
+    if (rec->wake) SDL_DestroySemaphore(rec->wake);
+    rec->wake = NULL;
+}
+
+int recorder_start(Recorder* rec, const char* path, int channels, int sample_rate) {
+    memset(rec, 0, sizeof(*rec));
+#ifndef _WIN32
+    rec->fd = -1;
+#endif
+    if (channels < 1 || channels > RECORD_MAX_CHANNELS || sample_rate <= 0) return 0;
+    rec->sample_rate = sample_rate;
+    rec->wav = has_wav_extension(path);
+    snprintf(rec->path, sizeof(rec->path), "%s", path);
+
+    for (int c = 0; c < channels; ++c) {
+        if (!sample_ring_init(&rec->rings[c], RECORD_RING_SECONDS * sample_rate)) {
+            recorder_release(rec);
+            return 0;
+        }
+        rec->channels = c + 1;
+    }
+    rec->allocation = malloc(RECORD_WRITE_BYTES + RECORD_ALIGN);
+    rec->wake = SDL_CreateSemaphore(0);
+    if (!rec->allocation || !rec->wake) {
+        recorder_release(rec);
+        return 0;
+    }
+    rec->buffer = (Uint8*)(((uintptr_t)rec->allocation + RECORD_ALIGN - 1) & ~(uintptr_t)(RECORD_ALIGN - 1));
+    if (!sink_open(rec)) {
+        fprintf(stderr, "Could not create recording '%s': %s\n", path, strerror(errno));
+        recorder_release(rec);
+        return 0;
+    }
+    if (rec->wav) {
+        write_wav_header(rec, rec->buffer);
+        rec->fill = RECORD_ALIGN;
+    }
+
+    rec->thread = SDL_CreateThread(writer_thread, "recorder", rec);
+    if (!rec->thread) {
+        fprintf(stderr, "Could not start the recorder thread: %s\n", SDL_GetError());
+        recorder_release(rec);
+        return 0;
+    }
+    SDL_AtomicSet(&rec->active, 1);
+    return 1;
+}
+
+void recorder_stop(Recorder* rec, SDL_AudioDeviceID device) {
+    if (!rec->thread) return;
+    if (device > 0) SDL_LockAudioDevice(device);
+    SDL_AtomicSet(&rec->active, 0);
+    if (device > 0) SDL_UnlockAudioDevice(device);
+
+    SDL_AtomicSet(&rec->stopping, 1);
+    SDL_SemPost(rec->wake);
+    SDL_WaitThread(rec->thread, NULL);
+    rec->thread = NULL;
+    recorder_release(rec);
+}
+
+int recorder_is_active(const Recorder* rec) {
+    return rec->thread != NULL;
+}
+
+// --- Capture Callback Side ---
+
+int recorder_accept(Recorder* rec, int frames) {
+    if (!SDL_AtomicGet(&rec->active)) return 0;
+    for (int c = 0; c < rec->channels; ++c) {
+        if (rec->rings[c].capacity - sample_ring_available(&rec->rings[c]) < frames) {
+            SDL_AtomicAdd(&rec->dropped_blocks, 1);
+            SDL_AtomicAdd(&rec->dropped_frames, frames);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void recorder_write(Recorder* rec, int channel, const Sint16* samples, int frames) {
+    sample_ring_write(&rec->rings[channel], samples, frames);
+}
@@ -0,0 +1,82 @@
+/*
+ * recorder.h - Record-to-disk of the live capture stream.
+ *
+ * recording_callback copies each captured block into the recorder's own
+ * rings, next to the capture rings the analyzer reads, and a writer thread
+ * drains them to a WAV or raw file. The callback never waits on the disk:
+ * a block that does not fit whole in the rings is dropped and counted, so
+ * a slow disk costs the file a gap instead of costing the device an
+ * overrun. Blocks are dropped whole, never in part, which keeps the
+ * channels aligned with each other.
+ *
+ * The writer interleaves into one large page-aligned buffer and hands it
+ * to the OS in a single write each time it fills. A WAV file's data chunk
+ * is padded to start on a RECORD_ALIGN boundary, so every write but the
+ * last covers whole aligned blocks of the file.
+ */
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <SDL.h>
+#include <stdio.h>
+#include "ringbuf.h"
+
+#define RECORD_MAX_CHANNELS 8
+#define RECORD_RING_SECONDS 4       // Disk stall the rings ride out.
+#define RECORD_ALIGN 4096
+#define RECORD_WRITE_BYTES (1 << 20)
+
+typedef struct {
+    int channels;
+    int sample_rate;
+    int wav;                        // Otherwise raw interleaved S16LE.
+    char path[1024];
+
+    // --- Shared with recording_callback ---
+    SampleRing rings[RECORD_MAX_CHANNELS];
+    SDL_atomic_t active;            // The callback taps only while set.
+    SDL_atomic_t dropped_blocks;
+    SDL_atomic_t dropped_frames;
+
+    // --- Writer thread ---
+    SDL_Thread* thread;
+    SDL_sem* wake;
+    SDL_atomic_t stopping;
+    SDL_atomic_t failed;            // Write error or full WAV; tapping has stopped.
+    SDL_atomic_t seconds;           // Whole seconds on disk so far.
+#ifdef _WIN32
+    FILE* file;
+#else
+    int fd;
+#endif
+    Uint8* allocation;
+    Uint8* buffer;                  // RECORD_WRITE_BYTES, RECORD_ALIGN-aligned.
+    size_t fill;
+    long long file_bytes;           // Written so far, header included.
+    Uint64 frames;
+} Recorder;
+
+// Creates `path` and starts the writer. A path ending in .wav gets a WAV
+// file, anything else raw interleaved 16-bit little-endian samples.
+// Returns 0, with the reason on stderr, if the file or thread cannot be
+// created.
+int recorder_start(Recorder* rec, const char* path, int channels, int sample_rate);
+
+// Takes the rest of the recording to disk, finalises the file and frees
+// the rings. The capture device is locked briefly so its callback cannot
+// be part-way through a block when tapping stops.
+void recorder_stop(Recorder* rec, SDL_AudioDeviceID device);
+
+// Whether a recording is open, even one that has failed and stopped tapping.
+int recorder_is_active(const Recorder* rec);
+
+// --- Capture Callback Side ---
+
+// Called once per block before its channels are written. Returns 1 if
+// the block fits whole in every ring, then recorder_write must be called
+// for each channel; otherwise the block is counted as dropped.
+int recorder_accept(Recorder* rec, int frames);
+void recorder_write(Recorder* rec, int channel, const Sint16* samples, int frames);
+
+#endif
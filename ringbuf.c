@@ -0,0 +1,82 @@
+/*
+ * ringbuf.c - Lock-free SPSC sample ring.
+ */
+
+#include "ringbuf.h"
+#include <stdlib.h>
+#include <string.h>
+
+int sample_ring_init(SampleRing* ring, int capacity) {
+    int size = 1;
+    while (size < capacity) size <<= 1;
+    ring->data = calloc(size, sizeof(Sint16));
+    if (!ring->data) return 0;
+    ring->capacity = size;
+    ring->mask = size - 1;
+    SDL_AtomicSet(&ring->write_pos, 0);
+    SDL_AtomicSet(&ring->read_pos, 0);
+    SDL_AtomicSet(&ring->dropped, 0);
+    return 1;
+}
+
+void sample_ring_free(SampleRing* ring) {
+    free(ring->data);
+    ring->data = NULL;
+}
+
+int sample_ring_write(SampleRing* ring, const Sint16* src, int count) {
+    Uint32 w = (Uint32)SDL_AtomicGet(&ring->write_pos);
+    Uint32 r = (Uint32)SDL_AtomicGet(&ring->read_pos);
+    int space = ring->capacity - (int)(w - r);
+    if (count > space) {
+        SDL_AtomicAdd(&ring->dropped, count - space);
+        count = space;
+    }
+    if (count <= 0) return 0;
+    // Pairs with the reader's release: its copies out of the space it has
+    // handed back finish before the overwrites below begin.
+    SDL_MemoryBarrierAcquire();
+
+    int start = (int)(w & (Uint32)ring->mask);
+    int first = count < ring->capacity - start ? count : ring->capacity - start;
+    memcpy(ring->data + start, src, first * sizeof(Sint16));
+    memcpy(ring->data, src + first, (count - first) * sizeof(Sint16));
+
+    // Publish the samples before the new write position becomes visible.
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&ring->write_pos, (int)(w + (Uint32)count));
+    return count;
+}
+
+int sample_ring_available(SampleRing* ring) {
+    Uint32 w = (Uint32)SDL_AtomicGet(&ring->write_pos);
+    Uint32 r = (Uint32)SDL_AtomicGet(&ring->read_pos);
+    return (int)(w - r);
+}
+
+int sample_ring_read(SampleRing* ring, Sint16* dst, int count) {
+    int available = sample_ring_available(ring);
+    if (count > available) count = available;
+    if (count <= 0) return 0;
+    SDL_MemoryBarrierAcquire();
+
+    Uint32 r = (Uint32)SDL_AtomicGet(&ring->read_pos);
+    int start = (int)(r & (Uint32)ring->mask);
+    int first = count < ring->capacity - start ? count : ring->capacity - start;
+    memcpy(dst, ring->data + start, first * sizeof(Sint16));
+    memcpy(dst + first, ring->data, (count - first) * sizeof(Sint16));
+
+    // Finish copying before handing the space back to the producer.
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&ring->read_pos, (int)(r + (Uint32)count));
+    return count;
+}
+
+int sample_ring_skip(SampleRing* ring, int count) {
+    int available = sample_ring_available(ring);
+    if (count > available) count = available;
+    if (count <= 0) return 0;
+    Uint32 r = (Uint32)SDL_AtomicGet(&ring->read_pos);
+    SDL_AtomicSet(&ring->read_pos, (int)(r + (Uint32)count));
+    return count;
+}
@@ -0,0 +1,36 @@
+/*
+ * ringbuf.h - Lock-free single-producer/single-consumer sample ring.
+ *
+ * The audio callback is the only writer and the analysis side is the only
+ * reader, so the two positions can be published with plain atomics and
+ * neither side ever takes a lock. When the reader falls behind, the writer
+ * drops the samples that do not fit and counts them instead of waiting.
+ */
+
+#ifndef RINGBUF_H
+#define RINGBUF_H
+
+#include <SDL.h>
+
+typedef struct {
+    Sint16* data;
+    int capacity;               // Power of two.
+    int mask;
+    SDL_atomic_t write_pos;     // Total samples written (wraps).
+    SDL_atomic_t read_pos;      // Total samples consumed (wraps).
+    SDL_atomic_t dropped;       // Samples discarded because the ring was full.
+} SampleRing;
+
+// Capacity is rounded up to a power of two. Returns 0 on allocation failure.
+int sample_ring_init(SampleRing* ring, int capacity);
+void sample_ring_free(SampleRing* ring);
+
+// Producer side. Returns the number of samples stored.
+int sample_ring_write(SampleRing* ring, const Sint16* src, int count);
+
+// Consumer side.
+int sample_ring_available(SampleRing* ring);
+int sample_ring_read(SampleRing* ring, Sint16* dst, int count);
+int sample_ring_skip(SampleRing* ring, int count);
+
+#endif
@@ -0,0 +1,253 @@
+/*
+ * siggen.c - Block renderer for the test signal generator.
+ */
+
+#include "siggen.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define DEFAULT_GAIN (12000.0f / 32767.0f)
+
+void siggen_init(SignalGenerator* gen, const Wavetables* tables, double sample_rate, int channels) {
+    memset(gen, 0, sizeof(*gen));
+    gen->tables = tables;
+    gen->sample_rate = sample_rate;
+    gen->channels = channels < 1 ? 1 : channels > SIGGEN_MAX_CHANNELS ? SIGGEN_MAX_CHANNELS : channels;
+}
+
+static int is_tonal(SignalType type) {
+    return type == SIGNAL_TONE || type == SIGNAL_SWEEP || type == SIGNAL_LOG_SWEEP || type == SIGNAL_STEPPED;
+}
+
+static double log_spaced(double from, double to, int index, int count) {
+    return count > 1 ? from * pow(to / from, (double)index / (count - 1)) : from;
+}
+
+int siggen_add_voice(SignalGenerator* gen, const Voice* config) {
+    if (gen->voice_count >= SIGGEN_MAX_VOICES) return 0;
+    Voice* v = &gen->voices[gen->voice_count];
+    *v = *config;
+    v->time = 0.0;
+    v->sweep_up = 1;
+    v->step = 0;
+    v->current_freq = v->freq;
+    memset(v->osc, 0, sizeof(v->osc));
+    memset(v->pink, 0, sizeof(v->pink));
+    v->noise = 0x9E3779B9u * (Uint32)(gen->voice_count + 1);
+
+    if (v->type == SIGNAL_MULTITONE) {
+        // Schroeder phases (pi * k^2 / N) keep the crest factor of the sum
+        // low, so the tones can share the headroom.
+        for (int k = 0; k < v->count; ++k) {
+            double turns = fmod((double)k * k / (2.0 * v->count), 1.0);
+            oscillator_set(&v->osc[k], gen->tables, WAVE_SINE, log_spaced(v->freq, v->freq_end, k, v->count), gen->sample_rate);
+            v->osc[k].phase = (Uint32)(turns * 4294967296.0);
+        }
+    }
+    gen->voice_count++;
+    return 1;
+}
+
+void siggen_set_wave(SignalGenerator* gen, WaveformType wave) {
+    for (int i = 0; i < gen->voice_count; ++i) {
+        if (is_tonal(gen->voices[i].type)) gen->voices[i].wave = wave;
+    }
+}
+
+// --- Parsing ---
+
+int siggen_parse_voice(const char* spec, Voice* voice) {
+    static const struct { const char* name; SignalType type; int params; } types[] = {
+        {"tone", SIGNAL_TONE, 1}, {"sweep", SIGNAL_SWEEP, 3}, {"logsweep", SIGNAL_LOG_SWEEP, 3},
+        {"stepped", SIGNAL_STEPPED, 4}, {"white", SIGNAL_WHITE_NOISE, 0}, {"pink", SIGNAL_PINK_NOISE, 0},
+        {"multitone", SIGNAL_MULTITONE, 3}
+    };
+    memset(voice, 0, sizeof(*voice));
+    voice->wave = WAVE_SINE;
+    voice->gain = DEFAULT_GAIN;
+    voice->channel_mask = (1u << SIGGEN_MAX_CHANNELS) - 1;
+
+    size_t name_length = strcspn(spec, ":@=");
+    int params = -1;
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+        if (strlen(types[i].name) == name_length && strncmp(spec, types[i].name, name_length) == 0) {
+            voice->type = types[i].type;
+            params = types[i].params;
+        }
+    }
+    if (params < 0) return 0;
+
+    const char* p = spec + name_length;
+    double args[4];
+    int count = 0;
+    while (*p == ':' && count < 4) {
+        char* end;
+        args[count] = strtod(p + 1, &end);
+        if (end == p + 1) return 0;
+        ++count;
+        p = end;
+    }
+    if (count != params) return 0;
+
+    if (*p == '@') {
+        voice->channel_mask = 0;
+        do {
+            char* end;
+            long channel = strtol(p + 1, &end, 10);
+            if (end == p + 1 || channel < 1 || channel > SIGGEN_MAX_CHANNELS) return 0;
+            voice->channel_mask |= 1u << (channel - 1);
+            p = end;
+        } while (*p == ',');
+    }
+    if (*p == '=') {
+        char* end;
+        double dbfs = strtod(p + 1, &end);
+        if (end == p + 1) return 0;
+        voice->gain = (float)pow(10.0, dbfs / 20.0);
+        p = end;
+    }
+    if (*p) return 0;
+
+    switch (voice->type) {
+        case SIGNAL_TONE:
+            voice->freq = args[0];
+            return voice->freq > 0.0;
+        case SIGNAL_SWEEP:
+        case SIGNAL_LOG_SWEEP:
+            voice->freq = args[0]; voice->freq_end = args[1]; voice->period = args[2];
+            return voice->freq > 0.0 && voice->freq_end > 0.0 && voice->period > 0.0;
+        case SIGNAL_STEPPED:
+            voice->freq = args[0]; voice->freq_end = args[1]; voice->count = (int)args[2]; voice->period = args[3];
+            return voice->freq > 0.0 && voice->freq_end > 0.0 && voice->count >= 1 && voice->period > 0.0;
+        case SIGNAL_MULTITONE:
+            voice->freq = args[0]; voice->freq_end = args[1]; voice->count = (int)args[2];
+            return voice->freq > 0.0 && voice->freq_end > 0.0 && voice->count >= 1 && voice->count <= MULTITONE_MAX;
+        default:
+            return 1;
+    }
+}
+
+// --- Rendering ---
+
+static double voice_freq(const Voice* v) {
+    double progress = v->time / v->period;
+    switch (v->type) {
+        case SIGNAL_SWEEP:
+            if (!v->sweep_up) progress = 1.0 - progress;
+            return v->freq + (v->freq_end - v->freq) * progress;
+        case SIGNAL_LOG_SWEEP:
+            if (!v->sweep_up) progress = 1.0 - progress;
+            return v->freq * pow(v->freq_end / v->freq, progress);
+        case SIGNAL_STEPPED:
+            return log_spaced(v->freq, v->freq_end, v->step, v->count);
+        default:
+            return v->freq;
+    }
+}
+
+// Sweeps and steps re-pitch every SIGGEN_STEP samples.
+static void render_moving(SignalGenerator* gen, Voice* v, float* out, int n) {
+    for (int done = 0; done < n; ) {
+        int chunk = n - done < SIGGEN_STEP ? n - done : SIGGEN_STEP;
+        v->current_freq = voice_freq(v);
+        oscillator_set(&v->osc[0], gen->tables, v->wave, v->current_freq, gen->sample_rate);
+        oscillator_render(&v->osc[0], out + done, chunk);
+        done += chunk;
+        if (gen->paused) continue;
+        v->time += chunk / gen->sample_rate;
+        if (v->time >= v->period) {
+            v->time = 0.0;
+            if (v->type == SIGNAL_STEPPED) v->step = (v->step + 1) % v->count;
+            else v->sweep_up = !v->sweep_up;
+        }
+    }
+}
+
+static inline float next_white(Uint32* state) {
+    Uint32 x = *state;
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    *state = x;
+    return (float)(Sint32)x * (1.0f / 2147483648.0f);
+}
+
+static void render_white(Voice* v, float* out, int n) {
+    Uint32 state = v->noise;
+    for (int i = 0; i < n; ++i) out[i] = next_white(&state);
+    v->noise = state;
+}
+
+// Paul Kellet's refined pink filter: a bank of one-pole sections whose sum
+// falls at 3 dB per octave to within 0.05 dB above 9 Hz.
+static void render_pink(Voice* v, float* out, int n) {
+    Uint32 state = v->noise;
+    float b0 = v->pink[0], b1 = v->pink[1], b2 = v->pink[2], b3 = v->pink[3];
+    float b4 = v->pink[4], b5 = v->pink[5], b6 = v->pink[6];
+    for (int i = 0; i < n; ++i) {
+        float white = next_white(&state);
+        b0 = 0.99886f * b0 + white * 0.0555179f;
+        b1 = 0.99332f * b1 + white * 0.0750759f;
+        b2 = 0.96900f * b2 + white * 0.1538520f;
+        b3 = 0.86650f * b3 + white * 0.3104856f;
+        b4 = 0.55000f * b4 + white * 0.5329522f;
+        b5 = -0.7616f * b5 - white * 0.0168980f;
+        out[i] = (b0 + b1 + b2 + b3 + b4 + b5 + b6 + white * 0.5362f) * 0.11f;
+        b6 = white * 0.115926f;
+    }
+    v->noise = state;
+    v->pink[0] = b0; v->pink[1] = b1; v->pink[2] = b2; v->pink[3] = b3;
+    v->pink[4] = b4; v->pink[5] = b5; v->pink[6] = b6;
+}
+
+static void render_multitone(SignalGenerator* gen, Voice* v, float* out, int n) {
+    const float tone_gain = 0.5f / sqrtf((float)v->count);
+    memset(out, 0, n * sizeof(float));
+    for (int k = 0; k < v->count; ++k) {
+        oscillator_render(&v->osc[k], gen->partial, n);
+        for (int i = 0; i < n; ++i) out[i] += tone_gain * gen->partial[i];
+    }
+}
+
+static void render_voice(SignalGenerator* gen, Voice* v, float* out, int n) {
+    switch (v->type) {
+        case SIGNAL_TONE:
+            v->current_freq = v->freq;
+            oscillator_set(&v->osc[0], gen->tables, v->wave, v->freq, gen->sample_rate);
+            oscillator_render(&v->osc[0], out, n);
+            break;
+        case SIGNAL_SWEEP:
+        case SIGNAL_LOG_SWEEP:
+        case SIGNAL_STEPPED: render_moving(gen, v, out, n); break;
+        case SIGNAL_WHITE_NOISE: render_white(v, out, n); break;
+        case SIGNAL_PINK_NOISE: render_pink(v, out, n); break;
+        case SIGNAL_MULTITONE: render_multitone(gen, v, out, n); break;
+    }
+}
+
+void siggen_render(SignalGenerator* gen, Sint16* out, int frames) {
+    const int channels = gen->channels;
+    for (int done = 0; done < frames; ) {
+        int n = frames - done < SIGGEN_BLOCK ? frames - done : SIGGEN_BLOCK;
+        for (int c = 0; c < channels; ++c) memset(gen->mix[c], 0, n * sizeof(float));
+
+        for (int i = 0; i < gen->voice_count; ++i) {
+            Voice* v = &gen->voices[i];
+            render_voice(gen, v, gen->scratch, n);
+            for (int c = 0; c < channels; ++c) {
+                if (!(v->channel_mask & (1u << c))) continue;
+                float* mix = gen->mix[c];
+                for (int k = 0; k < n; ++k) mix[k] += v->gain * gen->scratch[k];
+            }
+        }
+
+        for (int c = 0; c < channels; ++c) {
+            const float* mix = gen->mix[c];
+            Sint16* dst = out + done * channels + c;
+            for (int k = 0; k < n; ++k) {
+                float s = mix[k] * 32767.0f;
+                dst[k * channels] = s >= 32767.0f ? 32767 : s <= -32768.0f ? -32768 : (Sint16)s;
+            }
+        }
+        done += n;
+    }
+}
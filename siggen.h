@@ -0,0 +1,85 @@
+/*
+ * siggen.h - Multi-voice, multi-channel test signal generator.
+ *
+ * A generator mixes up to SIGGEN_MAX_VOICES voices onto up to
+ * SIGGEN_MAX_CHANNELS output channels. Each voice is one test signal:
+ * a steady tone, a linear or logarithmic sweep, a stepped sine, white or
+ * pink noise, or a Schroeder-phased multitone. Voices are rendered a block
+ * at a time. The choice of signal is made once per block, and the inner
+ * loops are plain array arithmetic with no per-sample branching.
+ */
+
+#ifndef SIGGEN_H
+#define SIGGEN_H
+
+#include <SDL.h>
+#include "oscillator.h"
+
+#define SIGGEN_MAX_VOICES 8
+#define SIGGEN_MAX_CHANNELS 8
+#define SIGGEN_BLOCK 256
+#define SIGGEN_STEP 64          // Samples between pitch updates in sweeps.
+#define MULTITONE_MAX 32
+
+typedef enum {
+    SIGNAL_TONE,            // freq
+    SIGNAL_SWEEP,           // freq -> freq_end and back, linearly, period s each way
+    SIGNAL_LOG_SWEEP,       // as above on a log frequency scale
+    SIGNAL_STEPPED,         // count log-spaced steps freq..freq_end, period s per step
+    SIGNAL_WHITE_NOISE,
+    SIGNAL_PINK_NOISE,
+    SIGNAL_MULTITONE        // count log-spaced sines freq..freq_end
+} SignalType;
+
+typedef struct {
+    // --- Configuration ---
+    SignalType type;
+    WaveformType wave;      // Tonal signals only; multitone is always sine.
+    double freq;
+    double freq_end;
+    double period;
+    int count;
+    float gain;             // Linear, 1.0 = full scale.
+    Uint32 channel_mask;    // Bit c plays on output channel c.
+
+    // --- State ---
+    double time;            // Seconds into the current sweep leg or step.
+    int sweep_up;
+    int step;
+    double current_freq;
+    Oscillator osc[MULTITONE_MAX];  // Tonal signals use osc[0].
+    Uint32 noise;
+    float pink[7];
+} Voice;
+
+typedef struct {
+    const Wavetables* tables;
+    double sample_rate;
+    int channels;
+    int paused;             // Holds sweeps and steps at their current pitch.
+    Voice voices[SIGGEN_MAX_VOICES];
+    int voice_count;
+    float scratch[SIGGEN_BLOCK];
+    float partial[SIGGEN_BLOCK];
+    float mix[SIGGEN_MAX_CHANNELS][SIGGEN_BLOCK];
+} SignalGenerator;
+
+void siggen_init(SignalGenerator* gen, const Wavetables* tables, double sample_rate, int channels);
+
+// Adds a voice with its state reset. Returns 0 if there is no room.
+int siggen_add_voice(SignalGenerator* gen, const Voice* config);
+
+// Parses "TYPE[:A[:B[:C]]][@CH[,CH...]][=DBFS]" into a voice, with
+// 1-based output channels (default: all) and a level in dBFS. Types:
+//   tone:HZ   sweep:FROM:TO:SECONDS   logsweep:FROM:TO:SECONDS
+//   stepped:FROM:TO:STEPS:SECONDS   white   pink   multitone:FROM:TO:TONES
+// Returns 0 on a malformed spec.
+int siggen_parse_voice(const char* spec, Voice* voice);
+
+// Renders `frames` interleaved frames of gen->channels Sint16 samples.
+void siggen_render(SignalGenerator* gen, Sint16* out, int frames);
+
+// Sets the waveform of every tonal voice.
+void siggen_set_wave(SignalGenerator* gen, WaveformType wave);
+
+#endif
@@ -0,0 +1,466 @@
+/*
+ * simd.c - Scalar, SSE2, AVX2 and NEON analysis kernels with runtime dispatch.
+ */
+
+#include "simd.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DSP_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__)
+#define DSP_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+#define POWER_FLOOR 1e-18
+#define DB_PER_LN (10.0 / 2.302585092994045684)   // 10 / ln(10)
+#define LN2 0.693147180559945309417
+#define SQRT2 1.41421356237309504880
+
+// --- Scalar Reference ---
+
+static void apply_window_scalar(const Sint16* in, const double* window, double* out, int n) {
+    for (int i = 0; i < n; ++i) out[i] = (double)in[i] * window[i];
+}
+
+static void power_to_db_scalar(const Complex* spectrum, double* db, int n) {
+    for (int i = 0; i < n; ++i) {
+        double power = spectrum[i].real * spectrum[i].real + spectrum[i].imag * spectrum[i].imag;
+        db[i] = 10.0 * log10(power + POWER_FLOOR);
+    }
+}
+
+static int peak_hold_update_scalar(double* hold, const double* db, int n, double decay) {
+    int peak = 0;
+    for (int i = 0; i < n; ++i) {
+        if (db[i] > db[peak]) peak = i;
+        double h = db[i] > hold[i] ? db[i] : hold[i];
+        hold[i] = h * decay;
+    }
+    return peak;
+}
+
+static void decay_scalar(double* hold, int n, double decay) {
+    for (int i = 0; i < n; ++i) hold[i] *= decay;
+}
+
+static void threshold_bits_scalar(const Sint16* in, int n, Sint16 threshold, Uint32* bits) {
+    for (int w = 0; w * 32 < n; ++w) {
+        Uint32 word = 0;
+        int end = n - w * 32 < 32 ? n - w * 32 : 32;
+        for (int b = 0; b < end; ++b) word |= (Uint32)(in[w * 32 + b] > threshold) << b;
+        bits[w] = word;
+    }
+}
+
+// Picks the first maximum from per-lane winners. Lanes only ever replace
+// their best on a strictly greater value, so each holds its first maximum.
+static int reduce_argmax(const double* best, const double* index, int lanes, const double* db, int tail_start, int n) {
+    int peak = (int)index[0];
+    double peak_db = best[0];
+    for (int l = 1; l < lanes; ++l) {
+        if (best[l] > peak_db || (best[l] == peak_db && (int)index[l] < peak)) {
+            peak_db = best[l];
+            peak = (int)index[l];
+        }
+    }
+    for (int i = tail_start; i < n; ++i) {
+        if (db[i] > peak_db) { peak_db = db[i]; peak = i; }
+    }
+    return peak;
+}
+
+static const DSPKernels scalar_kernels = {
+    DSP_SCALAR, "scalar", apply_window_scalar, power_to_db_scalar, peak_hold_update_scalar, decay_scalar,
+    threshold_bits_scalar
+};
+
+// --- SSE2 ---
+
+#ifdef DSP_HAVE_X86
+
+// 10 * log10(p) for positive, normal p. The exponent is split off, the
+// mantissa is folded into [sqrt(1/2), sqrt(2)) and ln(m) comes from
+// 2 * atanh((m - 1) / (m + 1)), whose series converges fast on that range.
+__attribute__((target("sse2")))
+static inline __m128d db_from_power_sse2(__m128d p) {
+    const __m128i mantissa_mask = _mm_set1_epi64x(0x000FFFFFFFFFFFFFLL);
+    const __m128i one_bits = _mm_set1_epi64x(0x3FF0000000000000LL);
+    const __m128d one = _mm_set1_pd(1.0);
+    __m128i bits = _mm_castpd_si128(p);
+    __m128i exponent = _mm_srli_epi64(bits, 52);
+    __m128d e = _mm_cvtepi32_pd(_mm_shuffle_epi32(exponent, _MM_SHUFFLE(3, 1, 2, 0)));
+    e = _mm_sub_pd(e, _mm_set1_pd(1023.0));
+    __m128d m = _mm_castsi128_pd(_mm_or_si128(_mm_and_si128(bits, mantissa_mask), one_bits));
+
+    __m128d big = _mm_cmpgt_pd(m, _mm_set1_pd(SQRT2));
+    m = _mm_or_pd(_mm_and_pd(big, _mm_mul_pd(m, _mm_set1_pd(0.5))), _mm_andnot_pd(big, m));
+    e = _mm_add_pd(e, _mm_and_pd(big, one));
+
+    __m128d s = _mm_div_pd(_mm_sub_pd(m, one), _mm_add_pd(m, one));
+    __m128d s2 = _mm_mul_pd(s, s);
+    __m128d poly = _mm_set1_pd(1.0 / 13.0);
+    poly = _mm_add_pd(_mm_mul_pd(poly, s2), _mm_set1_pd(1.0 / 11.0));
+    poly = _mm_add_pd(_mm_mul_pd(poly, s2), _mm_set1_pd(1.0 / 9.0));
+    poly = _mm_add_pd(_mm_mul_pd(poly, s2), _mm_set1_pd(1.0 / 7.0));
+    poly = _mm_add_pd(_mm_mul_pd(poly, s2), _mm_set1_pd(1.0 / 5.0));
+    poly = _mm_add_pd(_mm_mul_pd(poly, s2), _mm_set1_pd(1.0 / 3.0));
+    poly = _mm_add_pd(_mm_mul_pd(poly, s2), one);
+    __m128d ln_m = _mm_mul_pd(_mm_add_pd(s, s), poly);
+    __m128d ln_p = _mm_add_pd(_mm_mul_pd(e, _mm_set1_pd(LN2)), ln_m);
+    return _mm_mul_pd(ln_p, _mm_set1_pd(DB_PER_LN));
+}
+
+__attribute__((target("sse2")))
+static void apply_window_sse2(const Sint16* in, const double* window, double* out, int n) {
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i s = _mm_loadl_epi64((const __m128i*)(in + i));
+        __m128i s32 = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+        __m128d lo = _mm_cvtepi32_pd(s32);
+        __m128d hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(s32, _MM_SHUFFLE(1, 0, 3, 2)));
+        _mm_storeu_pd(out + i, _mm_mul_pd(lo, _mm_loadu_pd(window + i)));
+        _mm_storeu_pd(out + i + 2, _mm_mul_pd(hi, _mm_loadu_pd(window + i + 2)));
+    }
+    apply_window_scalar(in + i, window + i, out + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void power_to_db_sse2(const Complex* spectrum, double* db, int n) {
+    const double* x = (const double*)spectrum;
+    const __m128d floor_power = _mm_set1_pd(POWER_FLOOR);
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d a = _mm_loadu_pd(x + 2 * i);
+        __m128d b = _mm_loadu_pd(x + 2 * i + 2);
+        a = _mm_mul_pd(a, a);
+        b = _mm_mul_pd(b, b);
+        __m128d p = _mm_add_pd(_mm_unpacklo_pd(a, b), _mm_unpackhi_pd(a, b));
+        _mm_storeu_pd(db + i, db_from_power_sse2(_mm_add_pd(p, floor_power)));
+    }
+    power_to_db_scalar(spectrum + i, db + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static int peak_hold_update_sse2(double* hold, const double* db, int n, double decay) {
+    if (n < 2) return peak_hold_update_scalar(hold, db, n, decay);
+    const __m128d vdecay = _mm_set1_pd(decay);
+    const __m128d step = _mm_set1_pd(2.0);
+    __m128d best = _mm_loadu_pd(db);
+    __m128d best_index = _mm_set_pd(1.0, 0.0);
+    __m128d index = best_index;
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d d = _mm_loadu_pd(db + i);
+        __m128d h = _mm_loadu_pd(hold + i);
+        _mm_storeu_pd(hold + i, _mm_mul_pd(_mm_max_pd(h, d), vdecay));
+        __m128d gt = _mm_cmpgt_pd(d, best);
+        best = _mm_or_pd(_mm_and_pd(gt, d), _mm_andnot_pd(gt, best));
+        best_index = _mm_or_pd(_mm_and_pd(gt, index), _mm_andnot_pd(gt, best_index));
+        index = _mm_add_pd(index, step);
+    }
+    for (int t = i; t < n; ++t) {
+        double h = db[t] > hold[t] ? db[t] : hold[t];
+        hold[t] = h * decay;
+    }
+    double lanes[2], lane_index[2];
+    _mm_storeu_pd(lanes, best);
+    _mm_storeu_pd(lane_index, best_index);
+    return reduce_argmax(lanes, lane_index, 2, db, i, n);
+}
+
+__attribute__((target("sse2")))
+static void decay_sse2(double* hold, int n, double decay) {
+    const __m128d vdecay = _mm_set1_pd(decay);
+    int i = 0;
+    for (; i + 2 <= n; i += 2) _mm_storeu_pd(hold + i, _mm_mul_pd(_mm_loadu_pd(hold + i), vdecay));
+    decay_scalar(hold + i, n - i, decay);
+}
+
+// Saturating packs keep the 0 / -1 compare results, so one byte mask
+// covers 16 samples.
+__attribute__((target("sse2")))
+static void threshold_bits_sse2(const Sint16* in, int n, Sint16 threshold, Uint32* bits) {
+    const __m128i t = _mm_set1_epi16(threshold);
+    int w = 0;
+    for (; (w + 1) * 32 <= n; ++w) {
+        const __m128i* p = (const __m128i*)(in + w * 32);
+        __m128i a = _mm_packs_epi16(_mm_cmpgt_epi16(_mm_loadu_si128(p), t), _mm_cmpgt_epi16(_mm_loadu_si128(p + 1), t));
+        __m128i b = _mm_packs_epi16(_mm_cmpgt_epi16(_mm_loadu_si128(p + 2), t), _mm_cmpgt_epi16(_mm_loadu_si128(p + 3), t));
+        bits[w] = (Uint32)_mm_movemask_epi8(a) | (Uint32)_mm_movemask_epi8(b) << 16;
+    }
+    threshold_bits_scalar(in + w * 32, n - w * 32, threshold, bits + w);
+}
+
+static const DSPKernels sse2_kernels = {
+    DSP_SSE2, "sse2", apply_window_sse2, power_to_db_sse2, peak_hold_update_sse2, decay_sse2,
+    threshold_bits_sse2
+};
+
+// --- AVX2 ---
+
+__attribute__((target("avx2")))
+static inline __m256d db_from_power_avx2(__m256d p) {
+    const __m256i mantissa_mask = _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL);
+    const __m256i one_bits = _mm256_set1_epi64x(0x3FF0000000000000LL);
+    const __m256i pack_low = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    const __m256d one = _mm256_set1_pd(1.0);
+    __m256i bits = _mm256_castpd_si256(p);
+    __m256i exponent = _mm256_permutevar8x32_epi32(_mm256_srli_epi64(bits, 52), pack_low);
+    __m256d e = _mm256_sub_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(exponent)), _mm256_set1_pd(1023.0));
+    __m256d m = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, mantissa_mask), one_bits));
+
+    __m256d big = _mm256_cmp_pd(m, _mm256_set1_pd(SQRT2), _CMP_GT_OQ);
+    m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), big);
+    e = _mm256_add_pd(e, _mm256_and_pd(big, one));
+
+    __m256d s = _mm256_div_pd(_mm256_sub_pd(m, one), _mm256_add_pd(m, one));
+    __m256d s2 = _mm256_mul_pd(s, s);
+    __m256d poly = _mm256_set1_pd(1.0 / 13.0);
+    poly = _mm256_add_pd(_mm256_mul_pd(poly, s2), _mm256_set1_pd(1.0 / 11.0));
+    poly = _mm256_add_pd(_mm256_mul_pd(poly, s2), _mm256_set1_pd(1.0 / 9.0));
+    poly = _mm256_add_pd(_mm256_mul_pd(poly, s2), _mm256_set1_pd(1.0 / 7.0));
+    poly = _mm256_add_pd(_mm256_mul_pd(poly, s2), _mm256_set1_pd(1.0 / 5.0));
+    poly = _mm256_add_pd(_mm256_mul_pd(poly, s2), _mm256_set1_pd(1.0 / 3.0));
+    poly = _mm256_add_pd(_mm256_mul_pd(poly, s2), one);
+    __m256d ln_m = _mm256_mul_pd(_mm256_add_pd(s, s), poly);
+    __m256d ln_p = _mm256_add_pd(_mm256_mul_pd(e, _mm256_set1_pd(LN2)), ln_m);
+    return _mm256_mul_pd(ln_p, _mm256_set1_pd(DB_PER_LN));
+}
+
+__attribute__((target("avx2")))
+static void apply_window_avx2(const Sint16* in, const double* window, double* out, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i s32 = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(in + i)));
+        __m256d lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(s32));
+        __m256d hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(s32, 1));
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(lo, _mm256_loadu_pd(window + i)));
+        _mm256_storeu_pd(out + i + 4, _mm256_mul_pd(hi, _mm256_loadu_pd(window + i + 4)));
+    }
+    apply_window_scalar(in + i, window + i, out + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void power_to_db_avx2(const Complex* spectrum, double* db, int n) {
+    const double* x = (const double*)spectrum;
+    const __m256d floor_power = _mm256_set1_pd(POWER_FLOOR);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d a = _mm256_loadu_pd(x + 2 * i);
+        __m256d b = _mm256_loadu_pd(x + 2 * i + 4);
+        // hadd gives bins in the order 0, 2, 1, 3.
+        __m256d p = _mm256_hadd_pd(_mm256_mul_pd(a, a), _mm256_mul_pd(b, b));
+        p = _mm256_permute4x64_pd(p, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_pd(db + i, db_from_power_avx2(_mm256_add_pd(p, floor_power)));
+    }
+    power_to_db_sse2(spectrum + i, db + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static int peak_hold_update_avx2(double* hold, const double* db, int n, double decay) {
+    if (n < 4) return peak_hold_update_scalar(hold, db, n, decay);
+    const __m256d vdecay = _mm256_set1_pd(decay);
+    const __m256d step = _mm256_set1_pd(4.0);
+    __m256d best = _mm256_loadu_pd(db);
+    __m256d best_index = _mm256_setr_pd(0.0, 1.0, 2.0, 3.0);
+    __m256d index = best_index;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d d = _mm256_loadu_pd(db + i);
+        __m256d h = _mm256_loadu_pd(hold + i);
+        _mm256_storeu_pd(hold + i, _mm256_mul_pd(_mm256_max_pd(h, d), vdecay));
+        __m256d gt = _mm256_cmp_pd(d, best, _CMP_GT_OQ);
+        best = _mm256_blendv_pd(best, d, gt);
+        best_index = _mm256_blendv_pd(best_index, index, gt);
+        index = _mm256_add_pd(index, step);
+    }
+    for (int t = i; t < n; ++t) {
+        double h = db[t] > hold[t] ? db[t] : hold[t];
+        hold[t] = h * decay;
+    }
+    double lanes[4], lane_index[4];
+    _mm256_storeu_pd(lanes, best);
+    _mm256_storeu_pd(lane_index, best_index);
+    return reduce_argmax(lanes, lane_index, 4, db, i, n);
+}
+
+__attribute__((target("avx2")))
+static void decay_avx2(double* hold, int n, double decay) {
+    const __m256d vdecay = _mm256_set1_pd(decay);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) _mm256_storeu_pd(hold + i, _mm256_mul_pd(_mm256_loadu_pd(hold + i), vdecay));
+    decay_scalar(hold + i, n - i, decay);
+}
+
+// The 256-bit pack works within 128-bit lanes, so the quarters are put
+// back in order before taking the byte mask.
+__attribute__((target("avx2")))
+static void threshold_bits_avx2(const Sint16* in, int n, Sint16 threshold, Uint32* bits) {
+    const __m256i t = _mm256_set1_epi16(threshold);
+    int w = 0;
+    for (; (w + 1) * 32 <= n; ++w) {
+        const __m256i* p = (const __m256i*)(in + w * 32);
+        __m256i packed = _mm256_packs_epi16(_mm256_cmpgt_epi16(_mm256_loadu_si256(p), t), _mm256_cmpgt_epi16(_mm256_loadu_si256(p + 1), t));
+        bits[w] = (Uint32)_mm256_movemask_epi8(_mm256_permute4x64_epi64(packed, 0xD8));
+    }
+    threshold_bits_scalar(in + w * 32, n - w * 32, threshold, bits + w);
+}
+
+static const DSPKernels avx2_kernels = {
+    DSP_AVX2, "avx2", apply_window_avx2, power_to_db_avx2, peak_hold_update_avx2, decay_avx2,
+    threshold_bits_avx2
+};
+
+#endif
+
+// --- NEON (AArch64, which has double-precision vectors) ---
+
+#ifdef DSP_HAVE_NEON
+
+static inline float64x2_t db_from_power_neon(float64x2_t p) {
+    const uint64x2_t mantissa_mask = vdupq_n_u64(0x000FFFFFFFFFFFFFULL);
+    const uint64x2_t one_bits = vdupq_n_u64(0x3FF0000000000000ULL);
+    const float64x2_t one = vdupq_n_f64(1.0);
+    uint64x2_t bits = vreinterpretq_u64_f64(p);
+    float64x2_t e = vsubq_f64(vcvtq_f64_u64(vshrq_n_u64(bits, 52)), vdupq_n_f64(1023.0));
+    float64x2_t m = vreinterpretq_f64_u64(vorrq_u64(vandq_u64(bits, mantissa_mask), one_bits));
+
+    uint64x2_t big = vcgtq_f64(m, vdupq_n_f64(SQRT2));
+    m = vbslq_f64(big, vmulq_n_f64(m, 0.5), m);
+    e = vaddq_f64(e, vreinterpretq_f64_u64(vandq_u64(big, vreinterpretq_u64_f64(one))));
+
+    float64x2_t s = vdivq_f64(vsubq_f64(m, one), vaddq_f64(m, one));
+    float64x2_t s2 = vmulq_f64(s, s);
+    float64x2_t poly = vdupq_n_f64(1.0 / 13.0);
+    poly = vaddq_f64(vmulq_f64(poly, s2), vdupq_n_f64(1.0 / 11.0));
+    poly = vaddq_f64(vmulq_f64(poly, s2), vdupq_n_f64(1.0 / 9.0));
+    poly = vaddq_f64(vmulq_f64(poly, s2), vdupq_n_f64(1.0 / 7.0));
+    poly = vaddq_f64(vmulq_f64(poly, s2), vdupq_n_f64(1.0 / 5.0));
+    poly = vaddq_f64(vmulq_f64(poly, s2), vdupq_n_f64(1.0 / 3.0));
+    poly = vaddq_f64(vmulq_f64(poly, s2), one);
+    float64x2_t ln_m = vmulq_f64(vaddq_f64(s, s), poly);
+    float64x2_t ln_p = vaddq_f64(vmulq_n_f64(e, LN2), ln_m);
+    return vmulq_n_f64(ln_p, DB_PER_LN);
+}
+
+static void apply_window_neon(const Sint16* in, const double* window, double* out, int n) {
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        int32x4_t s32 = vmovl_s16(vld1_s16(in + i));
+        float64x2_t lo = vcvtq_f64_s64(vmovl_s32(vget_low_s32(s32)));
+        float64x2_t hi = vcvtq_f64_s64(vmovl_s32(vget_high_s32(s32)));
+        vst1q_f64(out + i, vmulq_f64(lo, vld1q_f64(window + i)));
+        vst1q_f64(out + i + 2, vmulq_f64(hi, vld1q_f64(window + i + 2)));
+    }
+    apply_window_scalar(in + i, window + i, out + i, n - i);
+}
+
+static void power_to_db_neon(const Complex* spectrum, double* db, int n) {
+    const double* x = (const double*)spectrum;
+    const float64x2_t floor_power = vdupq_n_f64(POWER_FLOOR);
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        float64x2x2_t c = vld2q_f64(x + 2 * i);
+        float64x2_t p = vaddq_f64(vmulq_f64(c.val[0], c.val[0]), vmulq_f64(c.val[1], c.val[1]));
+        vst1q_f64(db + i, db_from_power_neon(vaddq_f64(p, floor_power)));
+    }
+    power_to_db_scalar(spectrum + i, db + i, n - i);
+}
+
+static int peak_hold_update_neon(double* hold, const double* db, int n, double decay) {
+    if (n < 2) return peak_hold_update_scalar(hold, db, n, decay);
+    const float64x2_t step = vdupq_n_f64(2.0);
+    float64x2_t best = vld1q_f64(db);
+    const double first_index[2] = {0.0, 1.0};
+    float64x2_t best_index = vld1q_f64(first_index);
+    float64x2_t index = best_index;
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        float64x2_t d = vld1q_f64(db + i);
+        float64x2_t h = vld1q_f64(hold + i);
+        vst1q_f64(hold + i, vmulq_n_f64(vmaxq_f64(h, d), decay));
+        uint64x2_t gt = vcgtq_f64(d, best);
+        best = vbslq_f64(gt, d, best);
+        best_index = vbslq_f64(gt, index, best_index);
+        index = vaddq_f64(index, step);
+    }
+    for (int t = i; t < n; ++t) {
+        double h = db[t] > hold[t] ? db[t] : hold[t];
+        hold[t] = h * decay;
+    }
+    double lanes[2], lane_index[2];
+    vst1q_f64(lanes, best);
+    vst1q_f64(lane_index, best_index);
+    return reduce_argmax(lanes, lane_index, 2, db, i, n);
+}
+
+static void decay_neon(double* hold, int n, double decay) {
+    int i = 0;
+    for (; i + 2 <= n; i += 2) vst1q_f64(hold + i, vmulq_n_f64(vld1q_f64(hold + i), decay));
+    decay_scalar(hold + i, n - i, decay);
+}
+
+// NEON has no byte mask instruction: each compare byte keeps its own bit
+// weight and the halves are summed across lanes.
+static inline Uint32 byte_mask_neon(uint8x16_t m) {
+    static const uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t w = vandq_u8(m, vld1q_u8(weights));
+    return (Uint32)vaddv_u8(vget_low_u8(w)) | (Uint32)vaddv_u8(vget_high_u8(w)) << 8;
+}
+
+static void threshold_bits_neon(const Sint16* in, int n, Sint16 threshold, Uint32* bits) {
+    const int16x8_t t = vdupq_n_s16(threshold);
+    int w = 0;
+    for (; (w + 1) * 32 <= n; ++w) {
+        const Sint16* p = in + w * 32;
+        uint8x16_t a = vcombine_u8(vmovn_u16(vcgtq_s16(vld1q_s16(p), t)), vmovn_u16(vcgtq_s16(vld1q_s16(p + 8), t)));
+        uint8x16_t b = vcombine_u8(vmovn_u16(vcgtq_s16(vld1q_s16(p + 16), t)), vmovn_u16(vcgtq_s16(vld1q_s16(p + 24), t)));
+        bits[w] = byte_mask_neon(a) | byte_mask_neon(b) << 16;
+    }
+    threshold_bits_scalar(in + w * 32, n - w * 32, threshold, bits + w);
+}
+
+static const DSPKernels neon_kernels = {
+    DSP_NEON, "neon", apply_window_neon, power_to_db_neon, peak_hold_update_neon, decay_neon,
+    threshold_bits_neon
+};
+
+#endif
+
+// --- Dispatch ---
+
+const DSPKernels* dsp_kernels_for(DSPLevel level) {
+    switch (level) {
+        case DSP_SCALAR: return &scalar_kernels;
+#ifdef DSP_HAVE_X86
+        case DSP_SSE2: return SDL_HasSSE2() ? &sse2_kernels : NULL;
+        case DSP_AVX2: return SDL_HasSSE2() && SDL_HasAVX2() ? &avx2_kernels : NULL;
+#endif
+#ifdef DSP_HAVE_NEON
+        case DSP_NEON: return SDL_HasNEON() ? &neon_kernels : NULL;
+#endif
+        default: return NULL;
+    }
+}
+
+const DSPKernels* dsp_kernels_best(void) {
+    static const char* names[DSP_LEVEL_COUNT] = { "scalar", "sse2", "avx2", "neon" };
+    int cap = DSP_LEVEL_COUNT - 1;
+    const char* forced = getenv("ALAB_SIMD");
+    if (forced) {
+        for (int level = 0; level < DSP_LEVEL_COUNT; ++level) {
+            if (strcmp(names[level], forced) == 0) cap = level;
+        }
+    }
+    for (int level = cap; level > DSP_SCALAR; --level) {
+        const DSPKernels* k = dsp_kernels_for((DSPLevel)level);
+        if (k) return k;
+    }
+    return &scalar_kernels;
+}
@@ -0,0 +1,178 @@
+/*
+ * textcache.c - String texture cache and glyph atlases.
+ */
+
+#include "textcache.h"
+#include <string.h>
+
+static Uint32 hash_text(const char* text) {
+    Uint32 hash = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)text; *p; ++p) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+void text_cache_init(TextCache* cache, SDL_Renderer* renderer) {
+    memset(cache, 0, sizeof(*cache));
+    cache->renderer = renderer;
+}
+
+void text_cache_free(TextCache* cache) {
+    for (int i = 0; i < TEXT_CACHE_ENTRIES; ++i) {
+        if (cache->entries[i].texture) SDL_DestroyTexture(cache->entries[i].texture);
+    }
+    for (int i = 0; i < TEXT_CACHE_FONTS; ++i) {
+        if (cache->atlases[i].texture) SDL_DestroyTexture(cache->atlases[i].texture);
+    }
+    memset(cache, 0, sizeof(*cache));
+}
+
+void text_cache_flush(TextCache* cache) {
+    SDL_Renderer* renderer = cache->renderer;
+    text_cache_free(cache);
+    text_cache_init(cache, renderer);
+}
+
+static int aligned_x(int x, int w, TextAlign align) {
+    if (align == TEXT_ALIGN_RIGHT) return x - w;
+    if (align == TEXT_ALIGN_CENTER) return x - w / 2;
+    return x;
+}
+
+// --- String Cache ---
+
+static TextEntry* find_entry(TextCache* cache, TTF_Font* font, const char* text, SDL_Color color) {
+    Uint32 hash = hash_text(text);
+    TextEntry* victim = &cache->entries[0];
+    for (int i = 0; i < TEXT_CACHE_ENTRIES; ++i) {
+        TextEntry* e = &cache->entries[i];
+        if (e->texture && e->hash == hash && e->font == font &&
+            e->color.r == color.r && e->color.g == color.g && e->color.b == color.b && e->color.a == color.a &&
+            strcmp(e->text, text) == 0) {
+            e->last_used = ++cache->clock;
+            return e;
+        }
+        if (!victim->texture) continue;
+        if (!e->texture || e->last_used < victim->last_used) victim = e;
+    }
+
+    SDL_Surface* surface = TTF_RenderText_Blended(font, text, color);
+    if (!surface) return NULL;
+    SDL_Texture* texture = SDL_CreateTextureFromSurface(cache->renderer, surface);
+    int w = surface->w, h = surface->h;
+    SDL_FreeSurface(surface);
+    if (!texture) return NULL;
+
+    if (victim->texture) SDL_DestroyTexture(victim->texture);
+    victim->font = font;
+    victim->color = color;
+    victim->hash = hash;
+    strcpy(victim->text, text);
+    victim->texture = texture;
+    victim->w = w;
+    victim->h = h;
+    victim->last_used = ++cache->clock;
+    return victim;
+}
+
+int text_cache_draw(TextCache* cache, TTF_Font* font, const char* text, int x, int y, SDL_Color color, TextAlign align) {
+    if (!text[0]) return 0;
+    if (strlen(text) > TEXT_CACHE_MAX_LENGTH) {
+        // Too long to key; render it the slow way.
+        SDL_Surface* surface = TTF_RenderText_Blended(font, text, color);
+        if (!surface) return 0;
+        SDL_Texture* texture = SDL_CreateTextureFromSurface(cache->renderer, surface);
+        SDL_Rect rect = { aligned_x(x, surface->w, align), y, surface->w, surface->h };
+        SDL_RenderCopy(cache->renderer, texture, NULL, &rect);
+        SDL_DestroyTexture(texture);
+        SDL_FreeSurface(surface);
+        return rect.w;
+    }
+
+    TextEntry* e = find_entry(cache, font, text, color);
+    if (!e) return 0;
+    SDL_Rect rect = { aligned_x(x, e->w, align), y, e->w, e->h };
+    SDL_RenderCopy(cache->renderer, e->texture, NULL, &rect);
+    return e->w;
+}
+
+// --- Glyph Atlas ---
+
+// Renders every printable ASCII character once, in white, side by side on
+// one surface. The advance of each character becomes its cell width, so
+// copying cells back to back reproduces TTF_RenderText's layout for the
+// monospaced UI font.
+static int build_atlas(TextCache* cache, GlyphAtlas* atlas, TTF_Font* font) {
+    SDL_Color white = {255, 255, 255, 255};
+    SDL_Surface* glyphs[GLYPH_COUNT];
+    int height = TTF_FontHeight(font), width = 0;
+    for (int i = 0; i < GLYPH_COUNT; ++i) {
+        char text[2] = { (char)(GLYPH_FIRST + i), 0 };
+        int advance = 0;
+        glyphs[i] = TTF_RenderText_Blended(font, text, white);
+        if (glyphs[i]) {
+            advance = glyphs[i]->w;
+            if (glyphs[i]->h > height) height = glyphs[i]->h;
+        } else {
+            TTF_GlyphMetrics(font, (Uint16)text[0], NULL, NULL, NULL, NULL, &advance);
+        }
+        atlas->glyphs[i] = (SDL_Rect){ width, 0, advance, 0 };
+        width += advance;
+    }
+
+    int ok = 0;
+    SDL_Surface* sheet = width > 0 ? SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888) : NULL;
+    if (sheet) {
+        for (int i = 0; i < GLYPH_COUNT; ++i) {
+            atlas->glyphs[i].h = height;
+            if (!glyphs[i]) continue;
+            SDL_Rect dst = atlas->glyphs[i];
+            SDL_SetSurfaceBlendMode(glyphs[i], SDL_BLENDMODE_NONE);
+            SDL_BlitSurface(glyphs[i], NULL, sheet, &dst);
+        }
+        atlas->texture = SDL_CreateTextureFromSurface(cache->renderer, sheet);
+        if (atlas->texture) {
+            SDL_SetTextureBlendMode(atlas->texture, SDL_BLENDMODE_BLEND);
+            atlas->font = font;
+            atlas->height = height;
+            ok = 1;
+        }
+        SDL_FreeSurface(sheet);
+    }
+    for (int i = 0; i < GLYPH_COUNT; ++i) {
+        if (glyphs[i]) SDL_FreeSurface(glyphs[i]);
+    }
+    return ok;
+}
+
+static GlyphAtlas* get_atlas(TextCache* cache, TTF_Font* font) {
+    for (int i = 0; i < TEXT_CACHE_FONTS; ++i) {
+        GlyphAtlas* atlas = &cache->atlases[i];
+        if (atlas->font == font) return atlas;
+        if (!atlas->font) return build_atlas(cache, atlas, font) ? atlas : NULL;
+    }
+    return NULL;
+}
+
+int text_cache_draw_glyphs(TextCache* cache, TTF_Font* font, const char* text, int x, int y, SDL_Color color, TextAlign align) {
+    GlyphAtlas* atlas = get_atlas(cache, font);
+    if (!atlas) return text_cache_draw(cache, font, text, x, y, color, align);
+
+    int width = 0;
+    for (const unsigned char* p = (const unsigned char*)text; *p; ++p) {
+        if (*p >= GLYPH_FIRST && *p < GLYPH_FIRST + GLYPH_COUNT) width += atlas->glyphs[*p - GLYPH_FIRST].w;
+    }
+
+    SDL_SetTextureColorMod(atlas->texture, color.r, color.g, color.b);
+    SDL_SetTextureAlphaMod(atlas->texture, color.a);
+    SDL_Rect dst = { aligned_x(x, width, align), y, 0, atlas->height };
+    for (const unsigned char* p = (const unsigned char*)text; *p; ++p) {
+        if (*p < GLYPH_FIRST || *p >= GLYPH_FIRST + GLYPH_COUNT) continue;
+        const SDL_Rect* src = &atlas->glyphs[*p - GLYPH_FIRST];
+        dst.w = src->w;
+        if (src->w > 0) SDL_RenderCopy(cache->renderer, atlas->texture, src, &dst);
+        dst.x += src->w;
+    }
+    return width;
+}
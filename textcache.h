@@ -0,0 +1,67 @@
+/*
+ * textcache.h - Cached text rendering for the Audio Lab UI.
+ *
+ * Rasterising a string with SDL_ttf and uploading it as a texture costs a
+ * surface allocation and a GPU upload, which adds up when it happens for
+ * every label on every frame. Strings that rarely change (labels, ON/OFF)
+ * are kept as textures keyed by font, colour and text. Values that change
+ * from frame to frame (readouts, frequencies) are drawn from a per-font
+ * glyph atlas instead, so they cost one texture copy per character and no
+ * rasterising at all.
+ */
+
+#ifndef TEXTCACHE_H
+#define TEXTCACHE_H
+
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+#define TEXT_CACHE_ENTRIES 64
+#define TEXT_CACHE_MAX_LENGTH 63
+#define TEXT_CACHE_FONTS 4
+#define GLYPH_FIRST 32
+#define GLYPH_COUNT 95          // Printable ASCII.
+
+typedef enum { TEXT_ALIGN_LEFT, TEXT_ALIGN_RIGHT, TEXT_ALIGN_CENTER } TextAlign;
+
+typedef struct {
+    TTF_Font* font;
+    SDL_Color color;
+    Uint32 hash;
+    char text[TEXT_CACHE_MAX_LENGTH + 1];
+    SDL_Texture* texture;       // NULL marks a free entry.
+    int w, h;
+    Uint32 last_used;
+} TextEntry;
+
+typedef struct {
+    TTF_Font* font;             // NULL marks a free slot.
+    SDL_Texture* texture;       // White glyphs, tinted with the colour mod.
+    SDL_Rect glyphs[GLYPH_COUNT];
+    int height;
+} GlyphAtlas;
+
+typedef struct {
+    SDL_Renderer* renderer;
+    TextEntry entries[TEXT_CACHE_ENTRIES];
+    GlyphAtlas atlases[TEXT_CACHE_FONTS];
+    Uint32 clock;               // Bumped per lookup, for LRU eviction.
+} TextCache;
+
+void text_cache_init(TextCache* cache, SDL_Renderer* renderer);
+void text_cache_free(TextCache* cache);
+
+// Drops every texture, to be rebuilt on next use. Called when the renderer
+// reports its targets or device reset, which leaves their contents stale.
+void text_cache_flush(TextCache* cache);
+
+// Draws a mostly static string from the string cache, rendering it on the
+// first use. x is the left edge, right edge or centre depending on `align`.
+// Returns the drawn width.
+int text_cache_draw(TextCache* cache, TTF_Font* font, const char* text, int x, int y, SDL_Color color, TextAlign align);
+
+// Draws a frequently changing string glyph by glyph from the font's atlas.
+// Characters outside printable ASCII are skipped.
+int text_cache_draw_glyphs(TextCache* cache, TTF_Font* font, const char* text, int x, int y, SDL_Color color, TextAlign align);
+
+#endif
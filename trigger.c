@@ -0,0 +1,84 @@
+/*
+ * trigger.c - Level, slope, hysteresis and holdoff trigger over bit masks.
+ */
+
+#include "trigger.h"
+#include <string.h>
+
+#define MAX_HYSTERESIS 16000
+
+void trigger_init(Trigger* t, const DSPKernels* kernels) {
+    memset(t, 0, sizeof(*t));
+    t->kernels = kernels;
+}
+
+void trigger_configure(Trigger* t, int level, int hysteresis, TriggerSlope slope, int holdoff) {
+    if (hysteresis < 0) hysteresis = 0;
+    if (hysteresis > MAX_HYSTERESIS) hysteresis = MAX_HYSTERESIS;
+    if (level < hysteresis - 32767) level = hysteresis - 32767;
+    if (level > 32766 - hysteresis) level = 32766 - hysteresis;
+    if (holdoff < 0) holdoff = 0;
+    if (level == t->level && hysteresis == t->hysteresis && slope == t->slope && holdoff == t->holdoff) return;
+    t->level = level;
+    t->hysteresis = hysteresis;
+    t->slope = slope;
+    t->holdoff = holdoff;
+    t->armed = 0;
+    t->count = 0;
+}
+
+void trigger_scan(Trigger* t, const Sint16* samples, int count) {
+    Uint32 fire_bits[TRIGGER_BLOCK / 32];
+    Uint32 arm_bits[TRIGGER_BLOCK / 32];
+
+    // Each condition is one "greater than" compare, inverted where needed:
+    // rising fires on s >= level and arms on s < level - hysteresis, and
+    // falling fires on s <= level and arms on s > level + hysteresis.
+    const int rising = t->slope == TRIGGER_RISING;
+    const Sint16 fire_threshold = (Sint16)(rising ? t->level - 1 : t->level);
+    const Sint16 arm_threshold = (Sint16)(rising ? t->level - t->hysteresis - 1 : t->level + t->hysteresis);
+    const Uint32 fire_flip = rising ? 0u : ~0u;
+    const Uint32 arm_flip = rising ? ~0u : 0u;
+
+    for (int done = 0; done < count; ) {
+        int n = count - done < TRIGGER_BLOCK ? count - done : TRIGGER_BLOCK;
+        t->kernels->threshold_bits(samples + done, n, fire_threshold, fire_bits);
+        t->kernels->threshold_bits(samples + done, n, arm_threshold, arm_bits);
+        const Uint64 base = t->position;
+        const int words = (n + 31) / 32;
+        const Uint32 tail = n % 32 ? (1u << (n % 32)) - 1 : ~0u;
+
+        // Step from one event to the next: while disarmed look for the
+        // first arming sample, while armed for the first firing one.
+        // Nothing arms or fires during holdoff.
+        int i = t->holdoff_end > base ? (t->holdoff_end - base < (Uint64)n ? (int)(t->holdoff_end - base) : n) : 0;
+        while (i < n) {
+            int w = i / 32;
+            Uint32 word = t->armed ? fire_bits[w] ^ fire_flip : arm_bits[w] ^ arm_flip;
+            word &= ~0u << (i % 32);
+            if (w == words - 1) word &= tail;
+            if (!word) { i = (w + 1) * 32; continue; }
+            i = w * 32 + __builtin_ctz(word);
+            if (!t->armed) {
+                t->armed = 1;
+                continue;
+            }
+            t->history[t->count++ % TRIGGER_HISTORY] = base + i;
+            t->armed = 0;
+            t->holdoff_end = base + i + 1 + t->holdoff;
+            i = t->holdoff_end - base < (Uint64)n ? (int)(t->holdoff_end - base) : n;
+        }
+        t->position += n;
+        done += n;
+    }
+}
+
+int trigger_find(const Trigger* t, Uint64 first, Uint64 last, Uint64* position) {
+    Uint64 kept = t->count < TRIGGER_HISTORY ? t->count : TRIGGER_HISTORY;
+    for (Uint64 k = 1; k <= kept; ++k) {
+        Uint64 p = t->history[(t->count - k) % TRIGGER_HISTORY];
+        if (p < first) break;
+        if (p <= last) { *position = p; return 1; }
+    }
+    return 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * trigger.h - Oscilloscope trigger engine.
+ *
+ * The trigger watches the capture stream, not the display buffer. Each
+ * block is scanned once, as it arrives, and the engine remembers the
+ * sample positions of its recent triggers, so picking where to start a
+ * trace never rescans old samples.
+ *
+ * A rising trigger fires when the signal reaches `level` after having
+ * been below `level - hysteresis`, and a falling one mirrors that, so
+ * noise riding on a slow edge cannot fire it twice. After a trigger, none
+ * can fire until `holdoff` samples have passed. The level comparisons run
+ * as packed SIMD compares into bit masks, and the arm and fire states are
+ * stepped from one set bit to the next, so a block costs little more than
+ * the compares however many samples it holds.
+ */
+
+#ifndef TRIGGER_H
+#define TRIGGER_H
+
+#include <SDL.h>
+#include "simd.h"
+
+#define TRIGGER_HISTORY 64          // Power of two.
+#define TRIGGER_BLOCK 1024          // Samples compared per pass of the masks.
+
+typedef enum {
+    TRIGGER_OFF,                    // Free-running.
+    TRIGGER_AUTO,                   // Free-runs while nothing triggers.
+    TRIGGER_NORMAL,                 // Holds the last triggered trace.
+    TRIGGER_MODE_COUNT
+} TriggerMode;
+
+typedef enum { TRIGGER_RISING, TRIGGER_FALLING } TriggerSlope;
+
+typedef struct {
+    // --- Configuration ---
+    int level;
+    int hysteresis;
+    TriggerSlope slope;
+    int holdoff;                    // Samples.
+    const DSPKernels* kernels;
+
+    // --- State ---
+    Uint64 position;                // Samples scanned so far.
+    int armed;
+    Uint64 holdoff_end;             // First position that may fire again.
+    Uint64 history[TRIGGER_HISTORY];    // Positions of recent triggers.
+    Uint64 count;                   // Triggers fired; the newest is history[(count - 1) % TRIGGER_HISTORY].
+} Trigger;
+
+void trigger_init(Trigger* t, const DSPKernels* kernels);
+
+// Applies new settings to the samples scanned from now on. A change
+// disarms the trigger and forgets earlier triggers, which were found
+// under the old settings. The level is clamped so its arm level stays
+// inside the sample range.
+void trigger_configure(Trigger* t, int level, int hysteresis, TriggerSlope slope, int holdoff);
+
+// Scans the next `count` samples of the stream.
+void trigger_scan(Trigger* t, const Sint16* samples, int count);
+
+// Finds the newest trigger at a position from `first` to `last`
+// inclusive. Returns 0 if there is none.
+int trigger_find(const Trigger* t, Uint64 first, Uint64 last, Uint64* position);
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * waterfall.c - Streaming texture ring and row hand-off for the spectrogram.
+ */
+
+#include "waterfall.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int row_ring_init(RowRing* ring, int width, int capacity) {
+    ring->levels = calloc((size_t)width * capacity, 1);
+    if (!ring->levels) return 0;
+    ring->width = width;
+    ring->capacity = capacity;
+    SDL_AtomicSet(&ring->write_count, 0);
+    SDL_AtomicSet(&ring->read_count, 0);
+    SDL_AtomicSet(&ring->dropped, 0);
+    return 1;
+}
+
+void row_ring_free(RowRing* ring) {
+    free(ring->levels);
+    ring->levels = NULL;
+}
+
+Uint8* row_ring_begin(RowRing* ring) {
+    Uint32 w = (Uint32)SDL_AtomicGet(&ring->write_count);
+    Uint32 r = (Uint32)SDL_AtomicGet(&ring->read_count);
+    if ((int)(w - r) >= ring->capacity) {
+        SDL_AtomicIncRef(&ring->dropped);
+        return NULL;
+    }
+    // The renderer's reads of the slot come before its release.
+    SDL_MemoryBarrierAcquire();
+    return ring->levels + (size_t)(w & (ring->capacity - 1)) * ring->width;
+}
+
+void row_ring_commit(RowRing* ring) {
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicIncRef(&ring->write_count);
+}
+
+const Uint8* row_ring_peek(RowRing* ring) {
+    Uint32 w = (Uint32)SDL_AtomicGet(&ring->write_count);
+    Uint32 r = (Uint32)SDL_AtomicGet(&ring->read_count);
+    if (w == r) return NULL;
+    SDL_MemoryBarrierAcquire();
+    return ring->levels + (size_t)(r & (ring->capacity - 1)) * ring->width;
+}
+
+void row_ring_release(RowRing* ring) {
+    SDL_AtomicIncRef(&ring->read_count);
+}
+
+int row_ring_count(RowRing* ring) {
+    return (int)((Uint32)SDL_AtomicGet(&ring->write_count) - (Uint32)SDL_AtomicGet(&ring->read_count));
+}
+
+// Black through blue, magenta and orange to white, the usual heat ramp.
+static void build_palette(Uint32* palette) {
+    static const Uint8 stops[5][3] = { {0, 0, 0}, {20, 0, 140}, {200, 0, 120}, {255, 150, 0}, {255, 255, 255} };
+    for (int i = 0; i < 256; ++i) {
+        int segment = i * 4 / 256;
+        double t = (i * 4 % 256) / 256.0;
+        Uint32 rgb[3];
+        for (int c = 0; c < 3; ++c) rgb[c] = (Uint32)(stops[segment][c] + (stops[segment + 1][c] - stops[segment][c]) * t);
+        palette[i] = 0xFF000000u | (rgb[0] << 16) | (rgb[1] << 8) | rgb[2];
+    }
+}
+
+int waterfall_init(Waterfall* wf, SDL_Renderer* renderer, int width, int depth) {
+    memset(wf, 0, sizeof(*wf));
+    build_palette(wf->palette);
+    wf->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, depth);
+    if (!wf->texture) {
+        fprintf(stderr, "Could not create the waterfall texture: %s\n", SDL_GetError());
+        return 0;
+    }
+    wf->width = width;
+    wf->depth = depth;
+
+    void* pixels;
+    int pitch;
+    if (SDL_LockTexture(wf->texture, NULL, &pixels, &pitch) == 0) {
+        for (int y = 0; y < depth; ++y) {
+            Uint32* row = (Uint32*)((Uint8*)pixels + (size_t)y * pitch);
+            for (int x = 0; x < width; ++x) row[x] = wf->palette[0];
+        }
+        SDL_UnlockTexture(wf->texture);
+    }
+    return 1;
+}
+
+void waterfall_free(Waterfall* wf) {
+    if (wf->texture) SDL_DestroyTexture(wf->texture);
+    wf->texture = NULL;
+}
+
+void waterfall_push(Waterfall* wf, const Uint8* levels) {
+    if (!wf->texture) return;
+    wf->head = (wf->head + wf->depth - 1) % wf->depth;
+    SDL_Rect row_rect = {0, wf->head, wf->width, 1};
+    void* pixels;
+    int pitch;
+    if (SDL_LockTexture(wf->texture, &row_rect, &pixels, &pitch) != 0) return;
+    Uint32* row = pixels;
+    for (int x = 0; x < wf->width; ++x) row[x] = wf->palette[levels[x]];
+    SDL_UnlockTexture(wf->texture);
+}
+
+void waterfall_draw(const Waterfall* wf, SDL_Renderer* renderer, SDL_Rect dst) {
+    if (!wf->texture) return;
+    // Texture rows head..depth-1 are the newest part of the history, then
+    // rows 0..head-1 continue it.
+    int split = (int)((double)(wf->depth - wf->head) / wf->depth * dst.h + 0.5);
+    SDL_Rect newer_src = {0, wf->head, wf->width, wf->depth - wf->head};
+    SDL_Rect newer_dst = {dst.x, dst.y, dst.w, split};
+    SDL_RenderCopy(renderer, wf->texture, &newer_src, &newer_dst);
+    if (wf->head > 0) {
+        SDL_Rect older_src = {0, 0, wf->width, wf->head};
+        SDL_Rect older_dst = {dst.x, dst.y + split, dst.w, dst.h - split};
+        SDL_RenderCopy(renderer, wf->texture, &older_src, &older_dst);
+    }
+}
@@ -0,0 +1,70 @@
+/*
+ * waterfall.h - Scrolling spectrogram for the Audio Lab.
+ *
+ * The history lives in one streaming texture used as a circular buffer of
+ * rows. Each new analysis frame overwrites the oldest row in place and
+ * moves the head, and the view is drawn as two copies split at the head,
+ * so a frame costs one row upload and two texture copies however deep the
+ * history is.
+ *
+ * Rows are made on the analysis thread, once per hop. The display frame
+ * hand-off may skip frames, so rows travel through their own lock-free
+ * ring: the analysis thread is the only writer, the renderer the only
+ * reader, and rows that do not fit are dropped and counted. The renderer
+ * drains the ring whenever it wakes, and a ring passing its high-water
+ * mark wakes it, so rows keep flowing while redraws run at the idle rate.
+ */
+
+#ifndef WATERFALL_H
+#define WATERFALL_H
+
+#include <SDL.h>
+
+#define WATERFALL_RING_ROWS 64      // Power of two; several frames of hops.
+#define WATERFALL_RING_HIGH_WATER (WATERFALL_RING_ROWS / 2)  // Wakes the UI to drain.
+
+typedef struct {
+    Uint8* levels;              // capacity rows of `width` levels, 0..255.
+    int width;
+    int capacity;
+    SDL_atomic_t write_count;   // Rows written (wraps).
+    SDL_atomic_t read_count;    // Rows consumed (wraps).
+    SDL_atomic_t dropped;
+} RowRing;
+
+// Returns 0 on allocation failure.
+int row_ring_init(RowRing* ring, int width, int capacity);
+void row_ring_free(RowRing* ring);
+
+// Producer side: returns the slot to fill, or NULL if the ring is full
+// (the row is counted as dropped). row_ring_commit() publishes it.
+Uint8* row_ring_begin(RowRing* ring);
+void row_ring_commit(RowRing* ring);
+
+// Consumer side: the oldest unread row, or NULL. row_ring_release() frees it.
+const Uint8* row_ring_peek(RowRing* ring);
+void row_ring_release(RowRing* ring);
+
+// Rows written and not yet released, from either side.
+int row_ring_count(RowRing* ring);
+
+typedef struct {
+    SDL_Texture* texture;       // width x depth ARGB8888, streaming.
+    int width;
+    int depth;                  // Rows of history.
+    int head;                   // Texture row holding the newest line.
+    Uint32 palette[256];
+} Waterfall;
+
+// Creates the texture and clears it to the palette floor. Returns 0 on
+// failure, leaving the waterfall empty.
+int waterfall_init(Waterfall* wf, SDL_Renderer* renderer, int width, int depth);
+void waterfall_free(Waterfall* wf);
+
+// Writes one row of levels as the newest line.
+void waterfall_push(Waterfall* wf, const Uint8* levels);
+
+// Draws the history into `dst`, newest line at the top.
+void waterfall_draw(const Waterfall* wf, SDL_Renderer* renderer, SDL_Rect dst);
+
+#endif
@@ -0,0 +1,252 @@
+/*
+ * wavfile.c - Memory-mapped / chunked WAV and raw PCM streaming.
+ */
+
+#define _FILE_OFFSET_BITS 64
+#include "wavfile.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define WAVE_FORMAT_PCM 0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+#define MAP_WINDOW_BYTES (16 * 1024 * 1024)
+
+static Uint32 read_le32(const Uint8* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((Uint32)p[3] << 24); }
+static Uint16 read_le16(const Uint8* p) { return (Uint16)(p[0] | (p[1] << 8)); }
+
+static int has_wav_extension(const char* path) {
+    size_t len = strlen(path);
+    if (len < 4) return 0;
+    const char* ext = path + len - 4;
+    return ext[0] == '.' && (ext[1] | 0x20) == 'w' && (ext[2] | 0x20) == 'a' && (ext[3] | 0x20) == 'v';
+}
+
+// --- Platform file access ---
+
+static int source_open(AudioStream* stream, const char* path, long long* size) {
+#ifdef _WIN32
+    stream->file = fopen(path, "rb");
+    if (!stream->file) return 0;
+    _fseeki64(stream->file, 0, SEEK_END);
+    *size = _ftelli64(stream->file);
+#else
+    stream->fd = open(path, O_RDONLY);
+    if (stream->fd < 0) return 0;
+    struct stat st;
+    if (fstat(stream->fd, &st) != 0) return 0;
+    *size = st.st_size;
+#endif
+    return 1;
+}
+
+static int source_read_at(AudioStream* stream, long long offset, void* dst, size_t len) {
+#ifdef _WIN32
+    if (_fseeki64(stream->file, offset, SEEK_SET) != 0) return 0;
+    return fread(dst, 1, len, stream->file) == len;
+#else
+    return pread(stream->fd, dst, len, offset) == (ssize_t)len;
+#endif
+}
+
+// Makes `len` bytes at data position `position` addressable and returns
+// them. Mapping windows start on a page boundary and slide forward only
+// when the requested block would run past the end of the current one.
+static const Uint8* source_block(AudioStream* stream, long long position, size_t len) {
+    long long offset = stream->data_offset + position;
+#ifdef _WIN32
+    if (!source_read_at(stream, offset, stream->chunk, len)) return NULL;
+    return stream->chunk;
+#else
+    if (!stream->map || offset < stream->map_offset ||
+        offset + (long long)len > stream->map_offset + (long long)stream->map_length) {
+        if (stream->map) munmap(stream->map, stream->map_length);
+        long long page = sysconf(_SC_PAGESIZE);
+        stream->map_offset = offset - offset % page;
+        // A block of very wide frames can be larger than the usual window.
+        size_t needed = (size_t)(offset % page) + len;
+        stream->map_length = needed > MAP_WINDOW_BYTES ? needed : MAP_WINDOW_BYTES;
+        void* map = mmap(NULL, stream->map_length, PROT_READ, MAP_SHARED, stream->fd, stream->map_offset);
+        if (map == MAP_FAILED) { stream->map = NULL; return NULL; }
+        stream->map = map;
+        madvise(stream->map, stream->map_length, MADV_SEQUENTIAL);
+    }
+    return stream->map + (offset - stream->map_offset);
+#endif
+}
+
+// --- Format handling ---
+
+// Decodes one sample of the file's format into the Sint16 range.
+static double decode_sample(const Uint8* p, int bits, int is_float) {
+    if (is_float) {
+        Uint32 bits32 = read_le32(p);
+        float value;
+        memcpy(&value, &bits32, sizeof(value));
+        return value * 32767.0;
+    }
+    switch (bits) {
+        case 8:  return ((int)p[0] - 128) * 256.0;
+        case 16: return (Sint16)read_le16(p);
+        case 24: return (Sint32)((p[0] << 8) | (p[1] << 16) | ((Uint32)p[2] << 24)) / 65536.0;
+        default: return (Sint32)read_le32(p) / 65536.0;
+    }
+}
+
+static void downmix(const AudioStream* stream, const Uint8* data, int frames, Sint16* out) {
+    int bytes = stream->bits_per_sample / 8;
+    for (int i = 0; i < frames; ++i) {
+        const Uint8* frame = data + (size_t)i * stream->frame_bytes;
+        double sum = 0.0;
+        for (int c = 0; c < stream->channels; ++c) {
+            sum += decode_sample(frame + c * bytes, stream->bits_per_sample, stream->is_float);
+        }
+        double value = sum / stream->channels;
+        if (value > 32767.0) value = 32767.0;
+        if (value < -32768.0) value = -32768.0;
+        out[i] = (Sint16)value;
+    }
+}
+
+static int parse_wav(AudioStream* stream, long long size, const char* path, long long* data_size) {
+    Uint8 header[12];
+    if (size < 12 || !source_read_at(stream, 0, header, 12) ||
+        memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+        fprintf(stderr, "%s is not a RIFF/WAVE file\n", path);
+        return 0;
+    }
+
+    int have_fmt = 0;
+    int format = 0;
+    long long pos = 12;
+    while (pos + 8 <= size) {
+        Uint8 chunk[8];
+        if (!source_read_at(stream, pos, chunk, 8)) break;
+        long long chunk_size = read_le32(chunk + 4);
+        long long available = size - (pos + 8);
+        if (memcmp(chunk, "fmt ", 4) == 0 && chunk_size >= 16 && available >= 16) {
+            Uint8 body[26];
+            int body_len = chunk_size >= 26 && available >= 26 ? 26 : 16;
+            if (!source_read_at(stream, pos + 8, body, body_len)) break;
+            format = read_le16(body);
+            stream->channels = read_le16(body + 2);
+            stream->sample_rate = (int)read_le32(body + 4);
+            stream->bits_per_sample = read_le16(body + 14);
+            if (format == WAVE_FORMAT_EXTENSIBLE && body_len >= 26) format = read_le16(body + 24);
+            have_fmt = 1;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!have_fmt) break;
+            stream->is_float = format == WAVE_FORMAT_IEEE_FLOAT;
+            int bits = stream->bits_per_sample;
+            int supported = (format == WAVE_FORMAT_PCM && (bits == 8 || bits == 16 || bits == 24 || bits == 32)) ||
+                            (stream->is_float && bits == 32);
+            if (!supported || stream->channels < 1 || stream->sample_rate <= 0) {
+                fprintf(stderr, "%s: unsupported WAV format %d (%d-bit, %d channels)\n", path, format, bits, stream->channels);
+                return 0;
+            }
+            stream->data_offset = pos + 8;
+            *data_size = chunk_size < available ? chunk_size : available;
+            return 1;
+        }
+        pos += 8 + chunk_size + (chunk_size & 1);
+    }
+    fprintf(stderr, "%s: missing fmt or data chunk\n", path);
+    return 0;
+}
+
+// --- Public API ---
+
+int audio_stream_open(AudioStream* stream, const char* path, int raw_sample_rate) {
+    memset(stream, 0, sizeof(*stream));
+#ifndef _WIN32
+    stream->fd = -1;
+#endif
+    long long size = 0;
+    if (!source_open(stream, path, &size)) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        audio_stream_close(stream);
+        return 0;
+    }
+
+    long long data_size = size;
+    if (has_wav_extension(path)) {
+        if (!parse_wav(stream, size, path, &data_size)) {
+            audio_stream_close(stream);
+            return 0;
+        }
+    } else {
+        stream->sample_rate = raw_sample_rate;
+        stream->channels = 1;
+        stream->bits_per_sample = 16;
+    }
+    stream->frame_bytes = stream->channels * stream->bits_per_sample / 8;
+    stream->frame_count = data_size / stream->frame_bytes;
+
+    stream->staging = malloc(AUDIO_STREAM_BLOCK * sizeof(Sint16));
+#ifdef _WIN32
+    stream->chunk = malloc((size_t)AUDIO_STREAM_BLOCK * stream->frame_bytes);
+    if (!stream->chunk) { free(stream->staging); stream->staging = NULL; }
+#endif
+    if (!stream->staging) {
+        fprintf(stderr, "Out of memory\n");
+        audio_stream_close(stream);
+        return 0;
+    }
+    return 1;
+}
+
+const Sint16* audio_stream_next(AudioStream* stream, int* frames) {
+    long long total = stream->frame_count * stream->frame_bytes;
+    long long remaining = (total - stream->position) / stream->frame_bytes;
+    if (remaining <= 0) { *frames = 0; return NULL; }
+    int count = remaining < AUDIO_STREAM_BLOCK ? (int)remaining : AUDIO_STREAM_BLOCK;
+    size_t len = (size_t)count * stream->frame_bytes;
+
+    const Uint8* data = source_block(stream, stream->position, len);
+    if (!data) {
+        fprintf(stderr, "Read error at byte %lld of sample data\n", stream->position);
+        stream->failed = 1;
+        *frames = 0;
+        return NULL;
+    }
+    stream->position += len;
+    *frames = count;
+
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+    if (stream->channels == 1 && stream->bits_per_sample == 16 && !stream->is_float &&
+        ((uintptr_t)data & 1) == 0) {
+        return (const Sint16*)data;
+    }
+#endif
+    downmix(stream, data, count, stream->staging);
+    return stream->staging;
+}
+
+void audio_stream_seek(AudioStream* stream, long long frame) {
+    if (frame < 0) frame = 0;
+    if (frame > stream->frame_count) frame = stream->frame_count;
+    stream->position = frame * stream->frame_bytes;
+}
+
+void audio_stream_close(AudioStream* stream) {
+#ifdef _WIN32
+    if (stream->file) fclose(stream->file);
+    free(stream->chunk);
+    stream->file = NULL; stream->chunk = NULL;
+#else
+    if (stream->map) munmap(stream->map, stream->map_length);
+    if (stream->fd >= 0) close(stream->fd);
+    stream->map = NULL; stream->fd = -1;
+#endif
+    free(stream->staging);
+    stream->staging = NULL;
+}
@@ -0,0 +1,60 @@
+/*
+ * wavfile.h - Streaming audio file input for headless analysis.
+ *
+ * Reads RIFF/WAVE files (8/16/24/32-bit PCM and 32-bit float, any channel
+ * count) or headerless 16-bit little-endian PCM, block by block. On POSIX
+ * systems the data is memory-mapped through a sliding window; elsewhere it
+ * is read in fixed chunks into one reusable buffer. Either way memory use
+ * stays constant however long the file is.
+ *
+ * Mono 16-bit files are handed out straight from the mapping without a
+ * copy. Every other format is downmixed into a staging block of mono
+ * Sint16 samples, which is the only conversion pass.
+ */
+
+#ifndef WAVFILE_H
+#define WAVFILE_H
+
+#include <SDL.h>
+
+#define AUDIO_STREAM_BLOCK 4096     // Frames returned per audio_stream_next().
+
+typedef struct {
+    int sample_rate;
+    int channels;           // Channels in the file, before downmixing.
+    int bits_per_sample;
+    int is_float;
+    long long frame_count;
+    int failed;             // Set when a read error ended the stream early.
+
+    // --- Internal ---
+    int frame_bytes;
+    long long data_offset;  // File offset of the first sample.
+    long long position;     // Bytes of sample data consumed so far.
+#ifdef _WIN32
+    FILE* file;
+    Uint8* chunk;
+#else
+    int fd;
+    Uint8* map;
+    size_t map_length;
+    long long map_offset;   // File offset the current mapping starts at.
+#endif
+    Sint16* staging;
+} AudioStream;
+
+// Files whose name does not end in ".wav" are read as raw mono S16LE at
+// raw_sample_rate. Returns 0 and prints the reason to stderr on failure.
+int audio_stream_open(AudioStream* stream, const char* path, int raw_sample_rate);
+
+// Returns the next block of up to AUDIO_STREAM_BLOCK mono samples and sets
+// *frames to its length. The pointer stays valid until the next call.
+// Returns NULL at the end of the data.
+const Sint16* audio_stream_next(AudioStream* stream, int* frames);
+
+// Moves the read position to `frame`, clamped to the end of the data.
+void audio_stream_seek(AudioStream* stream, long long frame);
+
+void audio_stream_close(AudioStream* stream);
+
+#endif